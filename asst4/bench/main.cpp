@@ -0,0 +1,255 @@
+#include <getopt.h>
+#include <omp.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <algorithm>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "bfs/bfs.h"
+#include "common/benchmark.h"
+#include "common/graph.h"
+#include "components/components.h"
+#include "pagerank/page_rank.h"
+#include "sssp/sssp.h"
+
+#define PageRankDampening   0.3f
+#define PageRankConvergence 1e-7d
+
+// Output arrays of the kernels, sized for the current graph.  The work
+// functions read what the last run left in them.
+struct app_state {
+  solution bfs;
+  std::vector<int> distances;
+  std::vector<int> labels;
+  std::vector<double> scores;
+  int pr_iterations;
+  std::vector<pr_round_stats> pr_rounds;
+  int sssp_delta;
+};
+
+// Edges out of the vertices a traversal reached: what Graph500 counts
+// as traversed edges
+static long reached_edges(Graph g, const int* distances, int unreached) {
+  long edges = 0;
+#pragma omp parallel for reduction(+ : edges)
+  for (int v = 0; v < g->num_nodes; v++)
+    if (distances[v] != unreached) edges += outgoing_size(g, v);
+  return edges;
+}
+
+// The bytes below are lower bounds (see bench_work): the adjacency and
+// per-vertex arrays a kernel has to read or write at least once per
+// pass, ignoring the repeated misses of its random accesses.
+static std::vector<bench_kernel> make_kernels(Graph g, app_state* s) {
+  const double N = g->num_nodes;
+  std::vector<bench_kernel> kernels;
+
+  auto bfs_work = [s](Graph g) {
+    long edges = reached_edges(g, s->bfs.distances, -1);
+    // adjacency of the reached vertices, offsets, distances written
+    // and read
+    return bench_work{edges, 4.0 * edges + 12.0 * g->num_nodes};
+  };
+  kernels.push_back({"bfs/top_down", [s](Graph g) { bfs_top_down(g, &s->bfs); }, bfs_work});
+  kernels.push_back({"bfs/bottom_up", [s](Graph g) { bfs_bottom_up(g, &s->bfs); }, bfs_work});
+  kernels.push_back({"bfs/hybrid", [s](Graph g) { bfs_hybrid(g, &s->bfs); }, bfs_work});
+
+  kernels.push_back({"pr/pull",
+                     [s](Graph g) {
+                       double* sol = s->scores.data();
+                       for (int v = 0; v < g->num_nodes; v++) sol[v] = 1.0 / g->num_nodes;
+                       s->pr_iterations = pageRankIterate(g, sol, PageRankDampening,
+                                                          PageRankConvergence);
+                     },
+                     [s, N](Graph g) {
+                       // Per iteration: incoming edges and starts, contrib
+                       // read and written, inverse degrees, scores read
+                       // and written
+                       long iters = s->pr_iterations;
+                       return bench_work{iters * g->num_edges,
+                                         iters * (4.0 * g->num_edges + 44.0 * N)};
+                     }});
+  kernels.push_back({"pr/delta",
+                     [s](Graph g) {
+                       s->pr_rounds.clear();
+                       pageRankDelta(g, s->scores.data(), PageRankDampening,
+                                     PageRankConvergence, &s->pr_rounds);
+                     },
+                     [s](Graph) {
+                       // Per pushed edge: the edge and an atomic update of
+                       // the residual; per frontier vertex: its offset,
+                       // residual, score and inverse degree
+                       long edges = 0, vertices = 0;
+                       for (const pr_round_stats& r : s->pr_rounds) {
+                         edges += r.edges_processed;
+                         vertices += r.frontier_size;
+                       }
+                       return bench_work{edges, 20.0 * edges + 44.0 * vertices};
+                     }});
+
+  kernels.push_back({"sssp/delta_stepping",
+                     [s](Graph g) {
+                       sssp_delta_stepping(g, 0, s->sssp_delta, s->distances.data());
+                     },
+                     [s](Graph g) {
+                       long edges = reached_edges(g, s->distances.data(), SSSP_INFINITY);
+                       double per_edge = g->outgoing_weights ? 8.0 : 4.0;
+                       return bench_work{edges, per_edge * edges + 12.0 * g->num_nodes};
+                     }});
+
+  // Components look at every edge in both directions
+  auto cc_work = [](Graph g) {
+    return bench_work{g->num_edges, 8.0 * g->num_edges + 16.0 * g->num_nodes};
+  };
+  kernels.push_back({"cc/afforest", [s](Graph g) { cc_afforest(g, s->labels.data()); }, cc_work});
+  kernels.push_back({"cc/scc_coloring", [s](Graph g) { scc_coloring(g, s->labels.data()); }, cc_work});
+
+  return kernels;
+}
+
+static void app_state_init(app_state* s, Graph g) {
+  s->distances.assign(g->num_nodes, 0);
+  s->labels.assign(g->num_nodes, 0);
+  s->scores.assign(g->num_nodes, 0.0);
+  s->bfs.distances = s->distances.data();
+  s->pr_iterations = 0;
+
+  // Same default bucket width as the sssp harness: the average weight
+  long total_weight = g->num_edges;
+  if (g->outgoing_weights) {
+    total_weight = 0;
+    for (int e = 0; e < g->num_edges; e++) total_weight += g->outgoing_weights[e];
+  }
+  s->sssp_delta = g->num_edges ? std::max(1L, total_weight / g->num_edges) : 1;
+}
+
+// A kernel is selected by its full name or by its app ("bfs" selects
+// every bfs/ kernel)
+static bool selected(const std::string& name, const std::vector<std::string>& filters) {
+  if (filters.empty()) return true;
+  for (const std::string& f : filters)
+    if (name == f || name.compare(0, f.size() + 1, f + "/") == 0) return true;
+  return false;
+}
+
+static std::vector<std::string> split(const char* list) {
+  std::vector<std::string> items;
+  std::stringstream in(list);
+  std::string item;
+  while (std::getline(in, item, ','))
+    if (!item.empty()) items.push_back(item);
+  return items;
+}
+
+void usage(const char* binary_name) {
+  std::cerr << "Usage: " << binary_name
+            << " [options] <path/to/graph/file> [more graph files...]\n";
+  std::cerr << "\n";
+  std::cerr << "Options:\n";
+  std::cerr << "  -k  LIST kernels or apps to run, comma separated (default: all)\n";
+  std::cerr << "  -t  LIST thread counts, comma separated (default: 1, 2, 4, ..., max)\n";
+  std::cerr << "  -w  INT  warmup runs per configuration (default: 1)\n";
+  std::cerr << "  -r  INT  timed trials per configuration (default: 5)\n";
+  std::cerr << "  -c       cold runs: evict the caches before every run\n";
+  std::cerr << "  -p       read hardware counters with perf_event_open\n";
+  std::cerr << "  -f  FMT  output format: text, csv or json (default: text)\n";
+  std::cerr << "  -o  FILE write the results to FILE instead of stdout\n";
+  std::cerr << "  -l       list the kernels\n";
+  std::cerr << "  -h       this commandline help message\n";
+}
+
+int main(int argc, char** argv) {
+  bench_options options = bench_default_options();
+  std::vector<std::string> filters;
+  std::vector<int> thread_counts;
+  const char* out_filename = NULL;
+
+  int opt;
+  while ((opt = getopt(argc, argv, "k:t:w:r:cpf:o:lh")) != EOF) {
+    switch (opt) {
+      case 'k':
+        filters = split(optarg);
+        break;
+      case 't':
+        for (const std::string& t : split(optarg))
+          thread_counts.push_back(std::max(1, atoi(t.c_str())));
+        break;
+      case 'w':
+        options.warmup = std::max(0, atoi(optarg));
+        break;
+      case 'r':
+        options.trials = std::max(1, atoi(optarg));
+        break;
+      case 'c':
+        options.cold = true;
+        break;
+      case 'p':
+        options.counters = true;
+        break;
+      case 'f':
+        if (!strcmp(optarg, "text")) options.format = BENCH_TEXT;
+        else if (!strcmp(optarg, "csv")) options.format = BENCH_CSV;
+        else if (!strcmp(optarg, "json")) options.format = BENCH_JSON;
+        else {
+          std::cerr << "Unknown format: " << optarg << "\n";
+          usage(argv[0]);
+          exit(1);
+        }
+        break;
+      case 'o':
+        out_filename = optarg;
+        break;
+      case 'l': {
+        app_state state;
+        graph empty = {};
+        for (const bench_kernel& k : make_kernels(&empty, &state))
+          std::cout << k.name << "\n";
+        exit(0);
+      }
+      case 'h':
+      default:
+        usage(argv[0]);
+        exit(1);
+    }
+  }
+
+  if (optind >= argc) {
+    usage(argv[0]);
+    exit(1);
+  }
+
+  if (thread_counts.empty()) thread_counts = bench_thread_counts(omp_get_max_threads());
+
+  if (out_filename) {
+    options.out = fopen(out_filename, "w");
+    if (!options.out) {
+      fprintf(stderr, "Could not open: %s\n", out_filename);
+      exit(1);
+    }
+  }
+
+  // Progress goes to stderr, so that stdout only holds the results
+  bench_begin(options);
+  for (int i = optind; i < argc; i++) {
+    fprintf(stderr, "Loading graph %s...\n", argv[i]);
+    Graph g = load_graph_binary(argv[i]);
+
+    app_state state;
+    app_state_init(&state, g);
+    for (const bench_kernel& kernel : make_kernels(g, &state)) {
+      if (!selected(kernel.name, filters)) continue;
+      for (int threads : thread_counts)
+        bench_report(bench_run(g, argv[i], kernel, threads, options), options);
+    }
+    free_graph(g);
+  }
+  bench_end(options);
+
+  if (out_filename) fclose(options.out);
+  return 0;
+}
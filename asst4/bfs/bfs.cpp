@@ -5,19 +5,38 @@
 #include <stdlib.h>
 #include <string.h>
 
+#include <algorithm>
 #include <numeric>
 #include <execution>
+#include <vector>
 
 #include <cstddef>
 
 #include "../common/CycleTimer.h"
 #include "../common/graph.h"
+#include "../common/simd_gather.h"
 
 #define ROOT_NODE_ID       0
 #define NOT_VISITED_MARKER -1
 #define CHUNK 500
+
+// Direction-optimizing heuristics (Beamer et al.): go bottom-up once
+// the frontier's outgoing edges exceed 1/ALPHA of the edges left to
+// check, come back top-down once the frontier is below
+// num_nodes / BETA vertices and shrinking.
+#define ALPHA 14
+#define BETA  24
 // #define VERBOSE
 
+// Split each step's edge work into equal-sized chunks instead of
+// handing out whole vertices.  Set to 0 to get the vertex-granular
+// round-robin assignment for comparison (see VERBOSE output).
+#define EDGE_BALANCED 1
+// Smallest chunk of edges worth scheduling on its own
+#define MIN_EDGE_CHUNK 256
+// Chunks per thread, so that dynamic scheduling can smooth out the rest
+#define CHUNKS_PER_THREAD 8
+
 void vertex_set_clear(vertex_set *list) {
   list->count = 0;
 }
@@ -28,46 +47,136 @@ void vertex_set_init(vertex_set *list, int count) {
   vertex_set_clear(list);
 }
 
+void vertex_set_free(vertex_set *list) {
+  free(list->vertices);
+}
+
+// Scratch space for one step's edge offsets; both arrays hold
+// num_nodes + 1 ints.
+struct edge_offsets {
+  int *degrees;
+  int *offsets;
+};
+
+void edge_offsets_init(edge_offsets *scratch, int count) {
+  scratch->degrees = (int *) malloc(sizeof(int) * (count + 1));
+  scratch->offsets = (int *) malloc(sizeof(int) * (count + 1));
+}
+
+void edge_offsets_free(edge_offsets *scratch) {
+  free(scratch->degrees);
+  free(scratch->offsets);
+}
+
+// Turn degrees[0..count) into offsets[0..count]: offsets[i] is the
+// position of item i's first edge in the concatenation of all items'
+// edge lists, offsets[count] the total.
+static void compute_offsets(edge_offsets *scratch, int count) {
+  scratch->degrees[count] = 0;
+  std::exclusive_scan(std::execution::par, scratch->degrees,
+                      scratch->degrees + count + 1, scratch->offsets, 0);
+}
+
+// Work distribution for one step, called from inside a parallel region.
+// For every item i, visit(i, first, last) is called on sub-ranges of
+// its local edge indices [0, offsets[i+1] - offsets[i]).  With
+// EDGE_BALANCED, chunks hold an equal number of edges, so a high-degree
+// vertex is split across threads instead of stalling one of them.
+template <typename Visit>
+static void for_each_edge_range(const int *offsets, int count, Visit visit) {
+#if EDGE_BALANCED
+  int total = offsets[count];
+  int chunk = std::max(MIN_EDGE_CHUNK,
+                       total / (omp_get_num_threads() * CHUNKS_PER_THREAD) + 1);
+  int num_chunks = (total + chunk - 1) / chunk;
+
+#pragma omp for schedule(dynamic, 1) nowait
+  for (int c = 0; c < num_chunks; c++) {
+    int first = c * chunk;
+    int last = std::min(total, first + chunk);
+    // first item whose edge range contains `first`
+    int i = std::upper_bound(offsets, offsets + count + 1, first) - offsets - 1;
+    for (; i < count && offsets[i] < last; i++) {
+      int begin = std::max(first, offsets[i]) - offsets[i];
+      int end = std::min(last, offsets[i + 1]) - offsets[i];
+      if (begin < end) visit(i, begin, end);
+    }
+  }
+#else
+#pragma omp for schedule(static, 1) nowait
+  for (int i = 0; i < count; i++) visit(i, 0, offsets[i + 1] - offsets[i]);
+#endif
+}
+
+#ifdef VERBOSE
+// Per-thread busy time of the last step, to judge load balance.
+static std::vector<double> thread_busy;
+
+static void print_thread_balance() {
+  double max_busy = 0, sum_busy = 0;
+  for (double t : thread_busy) {
+    max_busy = std::max(max_busy, t);
+    sum_busy += t;
+  }
+  double avg_busy = sum_busy / thread_busy.size();
+  printf("    per-thread busy: max=%.4f avg=%.4f imbalance=%.2fx\n", max_busy,
+         avg_busy, avg_busy > 0 ? max_busy / avg_busy : 1.0);
+}
+#endif
+
 // Take one step of "top-down" BFS.  For each vertex on the frontier,
 // follow all outgoing edges, and add all neighboring vertices to the
 // new_frontier.
-void top_down_step(Graph g, vertex_set *frontier, vertex_set *new_frontier,
-                   int *distances) {
+//
+// If parents is not NULL, the BFS parent of every newly discovered
+// vertex is recorded as well.  Returns the number of edges inspected.
+long top_down_step(Graph g, vertex_set *frontier, vertex_set *new_frontier,
+                   int *distances, int *parents, edge_offsets *scratch) {
+#pragma omp parallel for schedule(dynamic, CHUNK)
+  for (int i = 0; i < frontier->count; i++)
+    scratch->degrees[i] = outgoing_size(g, frontier->vertices[i]);
+  compute_offsets(scratch, frontier->count);
+  const int *offsets = scratch->offsets;
+
+#ifdef VERBOSE
+  thread_busy.assign(omp_get_max_threads(), 0.0);
+#endif
+
 #pragma omp parallel
   {
-    int ID = omp_get_thread_num();
-    int numThreads = omp_get_num_threads();
-
-    // __thread vertex_set pt_frontier;
-    vertex_set pt_frontier;
-    vertex_set_init(&pt_frontier, g->num_nodes);
+#ifdef VERBOSE
+    double start_time = CycleTimer::currentSeconds();
+#endif
+    std::vector<int> pt_frontier;
 
-    for (int i = ID; i < frontier->count; i += numThreads) {
+    for_each_edge_range(offsets, frontier->count, [&](int i, int first, int last) {
       int node = frontier->vertices[i];
-
       int start_edge = g->outgoing_starts[node];
-      int end_edge = (node == g->num_nodes - 1) ? g->num_edges
-                                                : g->outgoing_starts[node + 1];
 
       // attempt to add all neighbors to the new frontier
-      for (int neighbor = start_edge; neighbor < end_edge; neighbor++) {
+      for (int neighbor = start_edge + first; neighbor < start_edge + last; neighbor++) {
         int outgoing = g->outgoing_edges[neighbor];
         if (distances[outgoing] == NOT_VISITED_MARKER && __sync_bool_compare_and_swap(distances + outgoing,
                                                                                       NOT_VISITED_MARKER,
                                                                                       distances[node] + 1)) {
-          pt_frontier.vertices[pt_frontier.count++] = outgoing;
+          if (parents) parents[outgoing] = node;
+          pt_frontier.push_back(outgoing);
         }
       }
-    }
+    });
+
+#ifdef VERBOSE
+    thread_busy[omp_get_thread_num()] = CycleTimer::currentSeconds() - start_time;
+#endif
 
 #pragma omp critical
     {
-      memcpy(new_frontier->vertices + new_frontier->count, pt_frontier.vertices, pt_frontier.count * sizeof(int));
-      new_frontier->count += pt_frontier.count;
+      memcpy(new_frontier->vertices + new_frontier->count, pt_frontier.data(), pt_frontier.size() * sizeof(int));
+      new_frontier->count += pt_frontier.size();
     }
-
-    vertex_set_clear(&pt_frontier);
   }
+
+  return offsets[frontier->count];
 }
 
 // Implements top-down BFS.
@@ -79,6 +188,8 @@ void bfs_top_down(Graph graph, solution *sol) {
   vertex_set list2;
   vertex_set_init(&list1, graph->num_nodes);
   vertex_set_init(&list2, graph->num_nodes);
+  edge_offsets scratch;
+  edge_offsets_init(&scratch, graph->num_nodes);
 
   vertex_set *frontier = &list1;
   vertex_set *new_frontier = &list2;
@@ -99,11 +210,12 @@ void bfs_top_down(Graph graph, solution *sol) {
 
     vertex_set_clear(new_frontier);
 
-    top_down_step(graph, frontier, new_frontier, sol->distances);
+    top_down_step(graph, frontier, new_frontier, sol->distances, NULL, &scratch);
 
 #ifdef VERBOSE
     double end_time = CycleTimer::currentSeconds();
     printf("frontier=%-10d %.4f sec\n", frontier->count, end_time - start_time);
+    print_thread_balance();
 #endif
 
     // swap pointers
@@ -111,58 +223,67 @@ void bfs_top_down(Graph graph, solution *sol) {
     frontier = new_frontier;
     new_frontier = tmp;
   }
+
+  vertex_set_free(&list1);
+  vertex_set_free(&list2);
+  edge_offsets_free(&scratch);
 }
 
-void bottom_up_step(Graph g, vertex_set *frontier, vertex_set *new_frontier,
-                    int *distances, int it) {
-  // ???
-  int *markedNotVisited = new int[g->num_nodes];
-  int *markedNotVisitedBi = new int[g->num_nodes];
-  int *markedNotVisitedPS = new int[g->num_nodes];
-#pragma omp parallel for schedule(dynamic, CHUNK)
-  for (int i = 0; i < g->num_nodes; ++i)
-    markedNotVisitedBi[i] = distances[i] == NOT_VISITED_MARKER ? 1 : 0;
-
-  std::exclusive_scan(std::execution::par,
-                      markedNotVisitedBi,
-                      markedNotVisitedBi + g->num_nodes,
-                      markedNotVisitedPS,
-                      0);
-  int numEmptyNodes = markedNotVisitedPS[g->num_nodes - 1] + markedNotVisitedBi[g->num_nodes - 1];
+// Take one step of "bottom-up" BFS.  Every unvisited vertex scans its
+// incoming edges for a parent on the current level (it) and joins
+// new_frontier as soon as it finds one.
+//
+// If parents is not NULL, the BFS parent of every newly discovered
+// vertex is recorded as well.  Returns the number of edges inspected.
+long bottom_up_step(Graph g, vertex_set *new_frontier, int *distances, int it,
+                    int *parents, edge_offsets *scratch) {
+  // Only unvisited vertices have work, so visited ones get no edges.
 #pragma omp parallel for schedule(dynamic, CHUNK)
   for (int i = 0; i < g->num_nodes; ++i)
-    if (markedNotVisitedBi[i] == 1)
-      markedNotVisited[markedNotVisitedPS[i]] = i;
-  delete[] markedNotVisitedPS;
-  delete[] markedNotVisitedBi;
+    scratch->degrees[i] = distances[i] == NOT_VISITED_MARKER ? incoming_size(g, i) : 0;
+  compute_offsets(scratch, g->num_nodes);
+  const int *offsets = scratch->offsets;
 
-  // printf("%d\n", numEmptyNodes);
+  long edges_inspected = 0;
 
-#pragma omp parallel for schedule(dynamic, CHUNK)
-  for (int i = 0; i < numEmptyNodes; ++i) {
-    int node = markedNotVisited[i]; // independent
-    assert(distances[node] == NOT_VISITED_MARKER);
+#ifdef VERBOSE
+  thread_busy.assign(omp_get_max_threads(), 0.0);
+#endif
 
-    // if (distances[node] != NOT_VISITED_MARKER)
-    //   continue;
+#pragma omp parallel reduction(+:edges_inspected)
+  {
+#ifdef VERBOSE
+    double start_time = CycleTimer::currentSeconds();
+#endif
 
-    int start_edge = g->incoming_starts[node];
-    int end_edge = (node == g->num_nodes - 1) ? g->num_edges
-                                              : g->incoming_starts[node + 1];
+    for_each_edge_range(offsets, g->num_nodes, [&](int node, int first, int last) {
+      // The incoming list of a big vertex may be split across chunks;
+      // another chunk may already have found a parent.
+      if (distances[node] != NOT_VISITED_MARKER)
+        return;
 
-    for (int neighbor = start_edge; neighbor < end_edge; neighbor++) {
-      int incoming = g->incoming_edges[neighbor];
-      if (distances[incoming] == it) {
+      const Vertex *edges = g->incoming_edges + g->incoming_starts[node] + first;
+      int range = last - first;
+      int k = find_first(distances, edges, range, it);
+      if (k < range) {
         // Add vertex v to frontier
-        distances[node] = it + 1;
-        int index = __sync_fetch_and_add(&new_frontier->count, 1);
-        new_frontier->vertices[index] = node;
-        break;
+        int incoming = edges[k];
+        if (__sync_bool_compare_and_swap(distances + node, NOT_VISITED_MARKER, it + 1)) {
+          if (parents) parents[node] = incoming;
+          int index = __sync_fetch_and_add(&new_frontier->count, 1);
+          new_frontier->vertices[index] = node;
+        }
+        k++;
       }
-    }
+      edges_inspected += k;
+    });
+
+#ifdef VERBOSE
+    thread_busy[omp_get_thread_num()] = CycleTimer::currentSeconds() - start_time;
+#endif
   }
 
-  delete[] markedNotVisited;
+  return edges_inspected;
 }
 
 void bfs_bottom_up(Graph graph, solution *sol) {
@@ -182,6 +303,8 @@ void bfs_bottom_up(Graph graph, solution *sol) {
   vertex_set list2;
   vertex_set_init(&list1, graph->num_nodes);
   vertex_set_init(&list2, graph->num_nodes);
+  edge_offsets scratch;
+  edge_offsets_init(&scratch, graph->num_nodes);
 
   vertex_set *frontier = &list1;
   vertex_set *new_frontier = &list2;
@@ -203,12 +326,13 @@ void bfs_bottom_up(Graph graph, solution *sol) {
 
     vertex_set_clear(new_frontier);
 
-    bottom_up_step(graph, frontier, new_frontier, sol->distances, it);
+    bottom_up_step(graph, new_frontier, sol->distances, it, NULL, &scratch);
     ++it;
 
 #ifdef VERBOSE
     double end_time = CycleTimer::currentSeconds();
     printf("frontier=%-10d %.4f sec\n", frontier->count, end_time - start_time);
+    print_thread_balance();
 #endif
 
     // swap pointers
@@ -216,49 +340,101 @@ void bfs_bottom_up(Graph graph, solution *sol) {
     frontier = new_frontier;
     new_frontier = tmp;
   }
+
+  vertex_set_free(&list1);
+  vertex_set_free(&list2);
+  edge_offsets_free(&scratch);
 }
 
-void bfs_hybrid(Graph graph, solution *sol) {
-  // CS149 students:
-  //
-  // You will need to implement the "hybrid" BFS here as
-  // described in the handout.
+// Sum of the outgoing degrees of all frontier vertices.
+static long frontier_edges(Graph g, vertex_set *frontier) {
+  long edges = 0;
+#pragma omp parallel for reduction(+:edges) schedule(dynamic, CHUNK)
+  for (int i = 0; i < frontier->count; i++)
+    edges += outgoing_size(g, frontier->vertices[i]);
+  return edges;
+}
 
+// Direction-optimizing BFS shared by bfs_hybrid and bfs_hybrid_tree.
+// parents and levels may be NULL if the caller does not need them.
+static void hybrid_search(Graph graph, int root, int *distances, int *parents,
+                          std::vector<bfs_level_stats> *levels) {
   vertex_set list1;
   vertex_set list2;
   vertex_set_init(&list1, graph->num_nodes);
   vertex_set_init(&list2, graph->num_nodes);
+  edge_offsets scratch;
+  edge_offsets_init(&scratch, graph->num_nodes);
 
   vertex_set *frontier = &list1;
   vertex_set *new_frontier = &list2;
 
   // initialize all nodes to NOT_VISITED
 #pragma omp parallel for schedule(dynamic, CHUNK)
-  for (int i = 0; i < graph->num_nodes; i++)
-    sol->distances[i] = NOT_VISITED_MARKER;
+  for (int i = 0; i < graph->num_nodes; i++) {
+    distances[i] = NOT_VISITED_MARKER;
+    if (parents) parents[i] = NOT_VISITED_MARKER;
+  }
 
   // setup frontier with the root node
-  frontier->vertices[frontier->count++] = ROOT_NODE_ID;
-  sol->distances[ROOT_NODE_ID] = 0;
+  frontier->vertices[frontier->count++] = root;
+  distances[root] = 0;
+  if (parents) parents[root] = root;
+  if (levels) levels->clear();
 
+  long edges_to_check = graph->num_edges;
+  bool bottom_up = false;
   int it = 0;
   while (frontier->count != 0) {
-#ifdef VERBOSE
     double start_time = CycleTimer::currentSeconds();
-#endif
+
+    long scout_count = frontier_edges(graph, frontier);
+    if (!bottom_up && scout_count > edges_to_check / ALPHA) {
+      bottom_up = true;
+    } else if (bottom_up && frontier->count < graph->num_nodes / BETA &&
+               new_frontier->count > frontier->count) {
+      // new_frontier still holds the previous level here
+      bottom_up = false;
+    }
 
     vertex_set_clear(new_frontier);
 
-    top_down_step(graph, frontier, new_frontier, sol->distances);
+    long edges_inspected;
+    if (bottom_up) {
+      edges_inspected = bottom_up_step(graph, new_frontier, distances, it,
+                                       parents, &scratch);
+    } else {
+      edges_to_check -= scout_count;
+      edges_inspected = top_down_step(graph, frontier, new_frontier,
+                                      distances, parents, &scratch);
+    }
 
-#ifdef VERBOSE
     double end_time = CycleTimer::currentSeconds();
-    printf("frontier=%-10d %.4f sec\n", frontier->count, end_time - start_time);
+#ifdef VERBOSE
+    printf("frontier=%-10d %.4f sec %s\n", frontier->count,
+           end_time - start_time, bottom_up ? "bottom-up" : "top-down");
+    print_thread_balance();
 #endif
+    if (levels)
+      levels->push_back({frontier->count, edges_inspected, bottom_up,
+                         end_time - start_time});
+    ++it;
 
-    // swap pointers
+    // swap pointers, keeping the old frontier's size for the heuristic
     vertex_set *tmp = frontier;
     frontier = new_frontier;
     new_frontier = tmp;
   }
+
+  vertex_set_free(&list1);
+  vertex_set_free(&list2);
+  edge_offsets_free(&scratch);
+}
+
+void bfs_hybrid(Graph graph, solution *sol) {
+  hybrid_search(graph, ROOT_NODE_ID, sol->distances, NULL, NULL);
+}
+
+void bfs_hybrid_tree(Graph graph, int root, bfs_tree *tree) {
+  hybrid_search(graph, root, tree->distances, tree->parents, &tree->levels);
 }
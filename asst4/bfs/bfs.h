@@ -3,6 +3,8 @@
 
 //#define DEBUG
 
+#include <vector>
+
 #include "common/graph.h"
 
 struct solution {
@@ -18,8 +20,32 @@ struct vertex_set {
   int* vertices;
 };
 
+struct bfs_level_stats {
+  // # of vertices on the frontier that was expanded
+  int frontier_size;
+  // # of edges looked at while expanding it
+  long edges_inspected;
+  // direction chosen for this level
+  bool bottom_up;
+  double seconds;
+};
+
+// Extended result of bfs_hybrid_tree
+struct bfs_tree {
+  int* distances;
+  // BFS parent of every vertex; the root is its own parent and
+  // unreached vertices have parent -1
+  int* parents;
+  // one entry per level, in traversal order
+  std::vector<bfs_level_stats> levels;
+};
+
 void bfs_top_down(Graph graph, solution* sol);
 void bfs_bottom_up(Graph graph, solution* sol);
 void bfs_hybrid(Graph graph, solution* sol);
 
+// Same traversal as bfs_hybrid, but from any root, and also records
+// the BFS tree and per-level statistics.
+void bfs_hybrid_tree(Graph graph, int root, bfs_tree* tree);
+
 #endif
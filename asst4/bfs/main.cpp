@@ -3,40 +3,282 @@
 #include <stdio.h>
 #include <stdlib.h>
 
+#include <algorithm>
 #include <iostream>
+#include <random>
 #include <sstream>
 #include <string>
 #include <vector>
 
 #include "bfs.h"
 #include "common/CycleTimer.h"
+#include "common/benchmark.h"
 #include "common/graph.h"
 
 #define USE_BINARY_GRAPH 1
 
+// Trials of the tree-recording overhead measurement in tree mode
+#define TREE_RUNS 8
+
+// Search roots sampled for TEPS in tree mode, as in Graph500
+#define TREE_ROOTS     64
+#define TREE_ROOT_SEED 1
+
 void reference_bfs_bottom_up(Graph graph, solution* sol);
 void reference_bfs_top_down(Graph graph, solution* sol);
 void reference_bfs_hybrid(Graph graph, solution* sol);
 
+// Graph500-style validation of a BFS tree from root, which needs no
+// reference solution:
+//   - the root is its own parent at level 0;
+//   - every other reached vertex has a parent one level closer to the
+//     root with an edge to it, and unreached vertices have none;
+//   - every edge (u, v) out of a reached u reaches v, at most one level
+//     further from the root.
+// Together these make the levels the BFS distances from root.
+static bool check_tree(Graph g, int root, bfs_tree* tree) {
+  const int* distances = tree->distances;
+  const int* parents = tree->parents;
+  if (distances[root] != 0 || parents[root] != root) {
+    fprintf(stderr, "*** Bad root %d: level %d, parent %d\n", root,
+            distances[root], parents[root]);
+    return false;
+  }
+
+  bool valid = true;
+#pragma omp parallel for schedule(dynamic, 1024) reduction(&& : valid)
+  for (int v = 0; v < g->num_nodes; v++) {
+    if (!valid || v == root) continue;
+    int parent = parents[v];
+    if (distances[v] == -1) {
+      if (parent != -1) {
+        fprintf(stderr, "*** Unreached vertex %d has parent %d\n", v, parent);
+        valid = false;
+      }
+      continue;
+    }
+
+    bool found = false;
+    if (parent >= 0 && parent < g->num_nodes &&
+        distances[parent] == distances[v] - 1)
+      for (const Vertex* u = incoming_begin(g, v); u != incoming_end(g, v); u++)
+        if (*u == parent) found = true;
+    if (!found) {
+      fprintf(stderr, "*** Bad parent for %d: %d\n", v, parent);
+      valid = false;
+      continue;
+    }
+
+    for (const Vertex* w = outgoing_begin(g, v); w != outgoing_end(g, v); w++)
+      if (distances[*w] == -1 || distances[*w] > distances[v] + 1) {
+        fprintf(stderr, "*** Edge %d -> %d spans levels %d, %d\n", v, *w,
+                distances[v], distances[*w]);
+        valid = false;
+        break;
+      }
+  }
+  return valid;
+}
+
+// Up to count distinct search roots, drawn with a fixed seed so runs
+// can be compared, among the vertices with an edge to another vertex
+// (Graph500 skips vertices of degree 0 and self-loops).
+static std::vector<int> sample_roots(Graph g, int count) {
+  std::vector<int> candidates;
+  for (int v = 0; v < g->num_nodes; v++)
+    for (const Vertex* w = outgoing_begin(g, v); w != outgoing_end(g, v); w++)
+      if (*w != v) {
+        candidates.push_back(v);
+        break;
+      }
+
+  // Partial Fisher-Yates shuffle; mt19937_64's output is the same on
+  // every platform, unlike the standard distributions.
+  std::mt19937_64 rng(TREE_ROOT_SEED);
+  count = std::min(count, (int)candidates.size());
+  for (int i = 0; i < count; i++) {
+    int j = i + (int)(rng() % (candidates.size() - i));
+    std::swap(candidates[i], candidates[j]);
+  }
+  candidates.resize(count);
+  return candidates;
+}
+
+// Whether every edge (u, v) of g has its reverse (v, u), i.e. g is an
+// undirected graph stored in both directions: the incoming edges of
+// every vertex are then the same multiset as its outgoing ones.
+static bool is_symmetric(Graph g) {
+  bool symmetric = true;
+#pragma omp parallel for schedule(dynamic, 1024) reduction(&& : symmetric)
+  for (int v = 0; v < g->num_nodes; v++) {
+    if (!symmetric || outgoing_size(g, v) != incoming_size(g, v)) {
+      symmetric = false;
+      continue;
+    }
+    std::vector<Vertex> out(outgoing_begin(g, v), outgoing_end(g, v));
+    std::vector<Vertex> in(incoming_begin(g, v), incoming_end(g, v));
+    std::sort(out.begin(), out.end());
+    std::sort(in.begin(), in.end());
+    if (out != in) symmetric = false;
+  }
+  return symmetric;
+}
+
+// Runs bfs_hybrid and bfs_hybrid_tree, reports the cost of recording the
+// tree, the per-level statistics and Graph500-style TEPS.
+static void run_tree_mode(Graph g, int thread_count) {
+  omp_set_num_threads(thread_count);
+  printf("----------------------------------------------------------\n");
+  std::cout << "Running with " << thread_count << " threads" << std::endl;
+
+  solution sol;
+  sol.distances = (int*)malloc(sizeof(int) * g->num_nodes);
+  solution ref;
+  ref.distances = (int*)malloc(sizeof(int) * g->num_nodes);
+  bfs_tree tree;
+  tree.distances = (int*)malloc(sizeof(int) * g->num_nodes);
+  tree.parents   = (int*)malloc(sizeof(int) * g->num_nodes);
+
+  // Cost of the tree and statistics: same search from root 0, which
+  // bfs_hybrid always starts from
+  double hybrid_time = 1e30, tree_time = 1e30;
+  for (int r = 0; r < TREE_RUNS; r++) {
+    double start = CycleTimer::currentSeconds();
+    bfs_hybrid(g, &sol);
+    hybrid_time = std::min(hybrid_time, CycleTimer::currentSeconds() - start);
+
+    start = CycleTimer::currentSeconds();
+    bfs_hybrid_tree(g, 0, &tree);
+    tree_time = std::min(tree_time, CycleTimer::currentSeconds() - start);
+  }
+
+  reference_bfs_hybrid(g, &ref);
+  bool correct = true;
+  for (int j = 0; j < g->num_nodes; j++) {
+    if (tree.distances[j] != ref.distances[j]) {
+      fprintf(stderr, "*** Results disagree at %d: %d, %d\n", j,
+              tree.distances[j], ref.distances[j]);
+      correct = false;
+      break;
+    }
+  }
+  correct = correct && check_tree(g, 0, &tree);
+
+  printf("----------------------------------------------------------\n");
+  std::cout << "Per-level statistics (root 0)" << std::endl;
+  printf("Level  Direction   Frontier        Edges    Time\n");
+  for (size_t l = 0; l < tree.levels.size(); l++) {
+    const bfs_level_stats& level = tree.levels[l];
+    printf("%5zu  %-9s %10d %12ld  %.4f\n", l,
+           level.bottom_up ? "bottom-up" : "top-down", level.frontier_size,
+           level.edges_inspected, level.seconds);
+  }
+  printf("----------------------------------------------------------\n");
+  printf("Hybrid:              %.4f sec\n", hybrid_time);
+  printf("Hybrid + tree/stats: %.4f sec (%+.1f%%)\n", tree_time,
+         100.0 * (tree_time - hybrid_time) / hybrid_time);
+
+  // Graph500 TEPS: one timed search from each sampled root, each tree
+  // validated, harmonic mean of the per-search TEPS
+  std::vector<int> roots = sample_roots(g, TREE_ROOTS);
+  // An undirected input edge is stored as two directed ones
+  const bool symmetric = is_symmetric(g);
+  double inv_teps_sum = 0;
+  double min_teps = 1e30, max_teps = 0;
+  long   traversed_sum = 0;
+
+  for (int root : roots) {
+    double start = CycleTimer::currentSeconds();
+    bfs_hybrid_tree(g, root, &tree);
+    double time = CycleTimer::currentSeconds() - start;
+
+    if (!check_tree(g, root, &tree)) {
+      fprintf(stderr, "*** Invalid BFS tree from root %d\n", root);
+      correct = false;
+      break;
+    }
+
+    // Graph500 counts every input edge in the traversed component once:
+    // on a symmetric graph, only the copy (v, u) with u >= v (the other
+    // end of an edge of a reached vertex is reached too)
+    long traversed = 0;
+#pragma omp parallel for reduction(+ : traversed)
+    for (int v = 0; v < g->num_nodes; v++) {
+      if (tree.distances[v] == -1) continue;
+      if (!symmetric) {
+        traversed += outgoing_size(g, v);
+        continue;
+      }
+      for (const Vertex* u = outgoing_begin(g, v); u != outgoing_end(g, v);
+           u++)
+        if (*u >= v) traversed++;
+    }
+    double teps = traversed / time;
+    inv_teps_sum += 1.0 / teps;
+    min_teps = std::min(min_teps, teps);
+    max_teps = std::max(max_teps, teps);
+    traversed_sum += traversed;
+  }
+
+  printf("----------------------------------------------------------\n");
+  if (correct && !roots.empty()) {
+    printf("Roots:               %zu sampled (seed %d), all trees valid\n",
+           roots.size(), TREE_ROOT_SEED);
+    printf("Traversed edges:     %.0f per search on average%s\n",
+           (double)traversed_sum / roots.size(),
+           symmetric ? " (undirected, each counted once)" : "");
+    printf("TEPS:                %.4g harmonic mean (min %.4g, max %.4g)\n",
+           roots.size() / inv_teps_sum, min_teps, max_teps);
+    printf("----------------------------------------------------------\n");
+  }
+  std::cout << "Correctness: " << std::endl;
+  if (!correct) std::cout << "BFS tree is not Correct" << std::endl;
+
+  free(sol.distances);
+  free(ref.distances);
+  free(tree.distances);
+  free(tree.parents);
+}
+
+void usage(const char* binary_name) {
+  std::cerr << "Usage: " << binary_name
+            << " [-t] <path/to/graph/file> [num_threads]\n";
+  std::cerr << "  To run results for all thread counts: <path/to/graph/file>\n";
+  std::cerr << "  Run with a certain number of threads (no correctness run): "
+               "<path/to/graph/file> <num_threads>\n";
+  std::cerr << "  -t  record the BFS tree and per-level statistics of the "
+               "hybrid search and report TEPS over sampled roots\n";
+}
+
 int main(int argc, char** argv) {
   int         num_threads = -1;
   std::string graph_filename;
+  bool        tree_mode = false;
+
+  int opt;
+  while ((opt = getopt(argc, argv, "th")) != EOF) {
+    switch (opt) {
+      case 't':
+        tree_mode = true;
+        break;
+      case 'h':
+      default:
+        usage(argv[0]);
+        exit(1);
+    }
+  }
 
-  if (argc < 2) {
-    std::cerr << "Usage: <path/to/graph/file> [num_threads]\n";
-    std::cerr
-        << "  To run results for all thread counts: <path/to/graph/file>\n";
-    std::cerr << "  Run with a certain number of threads (no correctness run): "
-                 "<path/to/graph/file> <num_threads>\n";
+  if (optind >= argc) {
+    usage(argv[0]);
     exit(1);
   }
 
   int thread_count = -1;
-  if (argc == 3) {
-    thread_count = atoi(argv[2]);
+  if (optind + 1 < argc) {
+    thread_count = atoi(argv[optind + 1]);
   }
 
-  graph_filename = argv[1];
+  graph_filename = argv[optind];
 
   Graph g;
 
@@ -52,7 +294,7 @@ int main(int argc, char** argv) {
   if (USE_BINARY_GRAPH) {
     g = load_graph_binary(graph_filename.c_str());
   } else {
-    g = load_graph(argv[1]);
+    g = load_graph(graph_filename.c_str());
     printf("storing binary form of graph!\n");
     store_graph_binary(graph_filename.append(".bin").c_str(), g);
     delete g;
@@ -63,19 +305,18 @@ int main(int argc, char** argv) {
   printf("  Edges: %d\n", g->num_edges);
   printf("  Nodes: %d\n", g->num_nodes);
 
+  if (tree_mode) {
+    run_tree_mode(g, thread_count > 0 ? thread_count : omp_get_max_threads());
+    free_graph(g);
+    return 0;
+  }
+
   // If we want to run on all threads
   if (thread_count <= -1) {
     // Static assignment to get consistent usage across trials
     int max_threads = omp_get_max_threads();
 
-    // static num_threadss
-    std::vector<int> num_threads;
-
-    // dynamic num_threads
-    for (int i = 1; i < max_threads; i *= 2) {
-      num_threads.push_back(i);
-    }
-    num_threads.push_back(max_threads);
+    std::vector<int> num_threads = bench_thread_counts(max_threads);
     int n_usage = num_threads.size();
 
     solution sol1;
@@ -0,0 +1,270 @@
+#include "benchmark.h"
+
+#include <linux/perf_event.h>
+#include <omp.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include <algorithm>
+
+#include "CycleTimer.h"
+
+// Size of the buffer streamed through to evict the caches, when the
+// last level cache size is unknown
+#define DEFAULT_FLUSH_BYTES (256L << 20)
+
+#define NUM_COUNTERS 3
+
+bench_options bench_default_options() {
+  bench_options options;
+  options.warmup = 1;
+  options.trials = 5;
+  options.cold = false;
+  options.counters = false;
+  options.format = BENCH_TEXT;
+  options.out = stdout;
+  return options;
+}
+
+// Writes every cache line of a buffer twice the size of the last level
+// cache, which pushes the graph and the kernel's arrays out of it
+static void flush_caches() {
+  static char* buffer = NULL;
+  static long size = 0;
+  if (!buffer) {
+    long llc = sysconf(_SC_LEVEL3_CACHE_SIZE);
+    size = llc > 0 ? 2 * llc : DEFAULT_FLUSH_BYTES;
+    buffer = (char*)aligned_alloc(64, size);
+    memset(buffer, 0, size);
+  }
+#pragma omp parallel for schedule(static)
+  for (long i = 0; i < size; i += 64) buffer[i]++;
+}
+
+// Hardware counters of the OpenMP threads.  Each thread of the team
+// opens counters for itself, so threads the kernel starts in some
+// other way (e.g. TBB behind std::execution) are not counted.
+struct perf_counters {
+  std::vector<int> fds;
+};
+
+static int perf_open(uint64_t config) {
+  perf_event_attr attr;
+  memset(&attr, 0, sizeof(attr));
+  attr.size = sizeof(attr);
+  attr.type = PERF_TYPE_HARDWARE;
+  attr.config = config;
+  attr.disabled = 1;
+  attr.exclude_kernel = 1;
+  attr.exclude_hv = 1;
+  return syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+}
+
+static void perf_close(perf_counters* counters) {
+  for (int fd : counters->fds)
+    if (fd >= 0) close(fd);
+  counters->fds.clear();
+}
+
+// Returns false (with nothing left open) if the counters are not
+// available, e.g. because of kernel.perf_event_paranoid
+static bool perf_init(perf_counters* counters) {
+  static const uint64_t configs[NUM_COUNTERS] = {
+      PERF_COUNT_HW_CPU_CYCLES, PERF_COUNT_HW_INSTRUCTIONS,
+      PERF_COUNT_HW_CACHE_MISSES};
+  bool ok = true;
+#pragma omp parallel
+  {
+    int fds[NUM_COUNTERS];
+    for (int c = 0; c < NUM_COUNTERS; c++) fds[c] = perf_open(configs[c]);
+#pragma omp critical
+    for (int c = 0; c < NUM_COUNTERS; c++) {
+      counters->fds.push_back(fds[c]);
+      if (fds[c] < 0) ok = false;
+    }
+  }
+  if (!ok) perf_close(counters);
+  return ok;
+}
+
+static void perf_start(perf_counters* counters) {
+  for (int fd : counters->fds) {
+    ioctl(fd, PERF_EVENT_IOC_RESET, 0);
+    ioctl(fd, PERF_EVENT_IOC_ENABLE, 0);
+  }
+}
+
+static bench_counters perf_stop(perf_counters* counters) {
+  double sums[NUM_COUNTERS] = {};
+  for (size_t i = 0; i < counters->fds.size(); i++) {
+    ioctl(counters->fds[i], PERF_EVENT_IOC_DISABLE, 0);
+    uint64_t value = 0;
+    if (read(counters->fds[i], &value, sizeof(value)) == sizeof(value))
+      sums[i % NUM_COUNTERS] += value;
+  }
+  return {true, sums[0], sums[1], sums[2]};
+}
+
+static double median(std::vector<double> values) {
+  std::sort(values.begin(), values.end());
+  size_t n = values.size();
+  return n % 2 ? values[n / 2] : (values[n / 2 - 1] + values[n / 2]) / 2;
+}
+
+bench_result bench_run(Graph g, const std::string& graph_name,
+                       const bench_kernel& kernel, int threads,
+                       const bench_options& options) {
+  omp_set_num_threads(threads);
+
+  for (int w = 0; w < options.warmup; w++) {
+    if (options.cold) flush_caches();
+    kernel.run(g);
+  }
+
+  perf_counters counters;
+  bool have_counters = false;
+  if (options.counters) {
+    have_counters = perf_init(&counters);
+    static bool warned = false;
+    if (!have_counters && !warned) {
+      fprintf(stderr,
+              "Hardware counters are not available (see "
+              "/proc/sys/kernel/perf_event_paranoid)\n");
+      warned = true;
+    }
+  }
+
+  bench_result result;
+  result.graph = graph_name;
+  result.kernel = kernel.name;
+  result.threads = threads;
+  result.trials = options.trials;
+
+  std::vector<double> times, cycles, instructions, llc_misses;
+  for (int t = 0; t < options.trials; t++) {
+    if (options.cold) flush_caches();
+    if (have_counters) perf_start(&counters);
+
+    double start = CycleTimer::currentSeconds();
+    kernel.run(g);
+    times.push_back(CycleTimer::currentSeconds() - start);
+
+    if (have_counters) {
+      bench_counters c = perf_stop(&counters);
+      cycles.push_back(c.cycles);
+      instructions.push_back(c.instructions);
+      llc_misses.push_back(c.llc_misses);
+    }
+  }
+  perf_close(&counters);
+
+  result.work = kernel.work(g);
+
+  result.median = median(times);
+  result.min = *std::min_element(times.begin(), times.end());
+  result.max = *std::max_element(times.begin(), times.end());
+  result.counters = {false, 0, 0, 0};
+  if (have_counters)
+    result.counters = {true, median(cycles), median(instructions),
+                       median(llc_misses)};
+  return result;
+}
+
+// Results printed since bench_begin, for the separators in JSON
+static int num_reported = 0;
+
+static std::string csv_field(const std::string& s) {
+  if (s.find_first_of(",\"\n") == std::string::npos) return s;
+  std::string quoted = "\"";
+  for (char c : s) quoted += (c == '"') ? std::string("\"\"") : std::string(1, c);
+  return quoted + "\"";
+}
+
+static std::string json_string(const std::string& s) {
+  std::string quoted = "\"";
+  for (char c : s) {
+    if (c == '"' || c == '\\') quoted += '\\';
+    quoted += c;
+  }
+  return quoted + "\"";
+}
+
+void bench_begin(const bench_options& options) {
+  num_reported = 0;
+  FILE* out = options.out;
+  switch (options.format) {
+    case BENCH_TEXT:
+      fprintf(out, "%-24s %-20s %7s %10s %10s %9s %8s", "Graph", "Kernel",
+              "Threads", "Median(s)", "Min(s)", "MTEPS", "GB/s");
+      if (options.counters)
+        fprintf(out, " %12s %6s %12s", "Cycles", "IPC", "LLC misses");
+      fprintf(out, "\n");
+      break;
+    case BENCH_CSV:
+      fprintf(out,
+              "graph,kernel,threads,trials,median_s,min_s,max_s,edges,bytes,"
+              "teps,bandwidth_gbs,cycles,instructions,llc_misses\n");
+      break;
+    case BENCH_JSON:
+      fprintf(out, "[");
+      break;
+  }
+}
+
+void bench_report(const bench_result& r, const bench_options& options) {
+  FILE* out = options.out;
+  double teps = r.work.edges / r.median;
+  double gbs = r.work.bytes / r.median / 1e9;
+  const bench_counters& c = r.counters;
+
+  switch (options.format) {
+    case BENCH_TEXT:
+      fprintf(out, "%-24s %-20s %7d %10.4f %10.4f %9.1f %8.2f",
+              r.graph.c_str(), r.kernel.c_str(), r.threads, r.median, r.min,
+              teps / 1e6, gbs);
+      if (c.valid)
+        fprintf(out, " %12.4g %6.2f %12.4g", c.cycles,
+                c.instructions / c.cycles, c.llc_misses);
+      else if (options.counters)
+        fprintf(out, " %12s %6s %12s", "-", "-", "-");
+      fprintf(out, "\n");
+      break;
+    case BENCH_CSV:
+      fprintf(out, "%s,%s,%d,%d,%.6f,%.6f,%.6f,%ld,%.0f,%.6g,%.6g",
+              csv_field(r.graph).c_str(), csv_field(r.kernel).c_str(),
+              r.threads, r.trials, r.median, r.min, r.max, r.work.edges,
+              r.work.bytes, teps, gbs);
+      if (c.valid)
+        fprintf(out, ",%.0f,%.0f,%.0f\n", c.cycles, c.instructions,
+                c.llc_misses);
+      else
+        fprintf(out, ",,,\n");
+      break;
+    case BENCH_JSON:
+      fprintf(out,
+              "%s\n  {\"graph\": %s, \"kernel\": %s, \"threads\": %d, "
+              "\"trials\": %d, \"median_s\": %.6f, \"min_s\": %.6f, "
+              "\"max_s\": %.6f, \"edges\": %ld, \"bytes\": %.0f, "
+              "\"teps\": %.6g, \"bandwidth_gbs\": %.6g",
+              num_reported ? "," : "", json_string(r.graph).c_str(),
+              json_string(r.kernel).c_str(), r.threads, r.trials, r.median,
+              r.min, r.max, r.work.edges, r.work.bytes, teps, gbs);
+      if (c.valid)
+        fprintf(out,
+                ", \"cycles\": %.0f, \"instructions\": %.0f, "
+                "\"llc_misses\": %.0f",
+                c.cycles, c.instructions, c.llc_misses);
+      fprintf(out, "}");
+      break;
+  }
+  num_reported++;
+  fflush(out);
+}
+
+void bench_end(const bench_options& options) {
+  if (options.format == BENCH_JSON) fprintf(options.out, "\n]\n");
+}
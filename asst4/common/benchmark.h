@@ -0,0 +1,97 @@
+#ifndef __BENCHMARK_H__
+#define __BENCHMARK_H__
+
+#include <stdio.h>
+
+#include <functional>
+#include <string>
+#include <vector>
+
+#include "graph.h"
+
+// Shared benchmark harness for the graph applications: runs kernels
+// over graphs and thread counts with warmup and repeated trials, and
+// reports the median and min time, traversed edges per second and the
+// memory bandwidth implied by the bytes the kernel has to touch.
+
+// Work done by one run of a kernel
+struct bench_work {
+  // Edges traversed (e.g. every edge once per PageRank iteration, the
+  // edges of the reached component for BFS)
+  long edges;
+  // Bytes the kernel cannot avoid moving: every array it reads or
+  // writes, counted once per pass over it.  Cache misses beyond these
+  // (e.g. on random gathers) are not counted, so the bandwidth derived
+  // from this is a lower bound on what the memory system delivered.
+  double bytes;
+};
+
+struct bench_kernel {
+  // "app/kernel", e.g. "bfs/hybrid"
+  std::string name;
+  // Runs the kernel once on the graph; this is what is timed
+  std::function<void(Graph)> run;
+  // Called after the trials to account for the work of the last run
+  // (from whatever state run left behind), outside the timed region
+  std::function<bench_work(Graph)> work;
+};
+
+enum bench_format { BENCH_TEXT, BENCH_CSV, BENCH_JSON };
+
+struct bench_options {
+  int warmup;
+  int trials;
+  // Evict the caches before every trial (and warmup run)
+  bool cold;
+  // Read hardware counters with perf_event_open
+  bool counters;
+  bench_format format;
+  FILE* out;
+};
+
+// Hardware counters summed over all threads, for one trial
+struct bench_counters {
+  bool valid;
+  double cycles;
+  double instructions;
+  double llc_misses;
+};
+
+struct bench_result {
+  std::string graph;
+  std::string kernel;
+  int threads;
+  int trials;
+  double median;
+  double min;
+  double max;
+  // Of the last trial; rates are computed from the median time
+  bench_work work;
+  // Medians over the trials, if options.counters was set
+  bench_counters counters;
+};
+
+// 1, 2, 4, ... up to and including max_threads: the thread counts the
+// harnesses sweep over by default
+static inline std::vector<int> bench_thread_counts(int max_threads) {
+  std::vector<int> num_threads;
+  for (int i = 1; i < max_threads; i *= 2) num_threads.push_back(i);
+  num_threads.push_back(max_threads);
+  return num_threads;
+}
+
+bench_options bench_default_options();
+
+// Runs kernel on g with the given number of OpenMP threads
+bench_result bench_run(Graph g, const std::string& graph_name,
+                       const bench_kernel& kernel, int threads,
+                       const bench_options& options);
+
+// Output in options.format: bench_begin once, bench_report for every
+// result and bench_end once.  Text is a table for people to read; CSV
+// has a header row; JSON is a single array of objects.
+void bench_begin(const bench_options& options);
+void bench_report(const bench_result& result, const bench_options& options);
+void bench_end(const bench_options& options);
+
+#endif /* __BENCHMARK_H__ */
@@ -8,11 +8,13 @@
 
 #include "graph_internal.h"
 
-#define GRAPH_HEADER_TOKEN ((int)0xDEADBEEF)
+#define GRAPH_HEADER_TOKEN          ((int)0xDEADBEEF)
+#define GRAPH_WEIGHTED_HEADER_TOKEN ((int)0xDEADBEFF)
 
 void free_graph(Graph graph) {
   free(graph->outgoing_starts);
   free(graph->outgoing_edges);
+  free(graph->outgoing_weights);
 
   free(graph->incoming_starts);
   free(graph->incoming_edges);
@@ -35,6 +37,14 @@ void build_edges(graph* graph, int* scratch) {
   }
 }
 
+void build_weights(graph* graph, int* scratch) {
+  int num_nodes           = graph->num_nodes;
+  graph->outgoing_weights = (Weight*)malloc(sizeof(Weight) * graph->num_edges);
+  for (int i = 0; i < graph->num_edges; i++) {
+    graph->outgoing_weights[i] = scratch[num_nodes + graph->num_edges + i];
+  }
+}
+
 // Given an outgoing edge adjacency list representation for a directed
 // graph, build an incoming adjacency list representation
 void build_incoming_edges(graph* graph) {
@@ -125,13 +135,16 @@ void build_incoming_edges(graph* graph) {
   free(node_scatter);
 }
 
-void get_meta_data(std::ifstream& file, graph* graph) {
+// Returns true if the file holds a weighted graph, in which case the
+// edge weights follow the outgoing edges in the file.
+bool get_meta_data(std::ifstream& file, graph* graph) {
   // going back to the beginning of the file
   file.clear();
   file.seekg(0, std::ios::beg);
   std::string buffer;
   std::getline(file, buffer);
-  if ((buffer.compare(std::string("AdjacencyGraph")))) {
+  bool weighted = !buffer.compare(std::string("WeightedAdjacencyGraph"));
+  if (!weighted && (buffer.compare(std::string("AdjacencyGraph")))) {
     std::cout << "Invalid input file" << buffer << std::endl;
     exit(1);
   }
@@ -149,6 +162,7 @@ void get_meta_data(std::ifstream& file, graph* graph) {
   } while (buffer.size() == 0 || buffer[0] == '#');
 
   graph->num_edges = atoi(buffer.c_str());
+  return weighted;
 }
 
 void read_graph_file(std::ifstream& file, int* scratch) {
@@ -207,14 +221,16 @@ Graph load_graph(const char* filename) {
   // open the file
   std::ifstream graph_file;
   graph_file.open(filename);
-  get_meta_data(graph_file, graph);
+  bool weighted = get_meta_data(graph_file, graph);
 
-  int* scratch =
-      (int*)malloc(sizeof(int) * (graph->num_nodes + graph->num_edges));
+  int  num_values = graph->num_nodes + graph->num_edges * (weighted ? 2 : 1);
+  int* scratch    = (int*)malloc(sizeof(int) * num_values);
   read_graph_file(graph_file, scratch);
 
   build_start(graph, scratch);
   build_edges(graph, scratch);
+  graph->outgoing_weights = NULL;
+  if (weighted) build_weights(graph, scratch);
   free(scratch);
 
   build_incoming_edges(graph);
@@ -241,7 +257,8 @@ Graph load_graph_binary(const char* filename) {
     exit(1);
   }
 
-  if (header[0] != GRAPH_HEADER_TOKEN) {
+  if (header[0] != GRAPH_HEADER_TOKEN &&
+      header[0] != GRAPH_WEIGHTED_HEADER_TOKEN) {
     fprintf(stderr, "Invalid graph file header. File may be corrupt.\n");
     exit(1);
   }
@@ -264,6 +281,17 @@ Graph load_graph_binary(const char* filename) {
     exit(1);
   }
 
+  graph->outgoing_weights = NULL;
+  if (header[0] == GRAPH_WEIGHTED_HEADER_TOKEN) {
+    graph->outgoing_weights =
+        (Weight*)malloc(sizeof(Weight) * graph->num_edges);
+    if (fread(graph->outgoing_weights, sizeof(Weight), graph->num_edges,
+              input) != (size_t)graph->num_edges) {
+      fprintf(stderr, "Error reading weights.\n");
+      exit(1);
+    }
+  }
+
   fclose(input);
 
   build_incoming_edges(graph);
@@ -280,7 +308,8 @@ void store_graph_binary(const char* filename, Graph graph) {
   }
 
   int header[3];
-  header[0] = GRAPH_HEADER_TOKEN;
+  header[0] = graph->outgoing_weights ? GRAPH_WEIGHTED_HEADER_TOKEN
+                                      : GRAPH_HEADER_TOKEN;
   header[1] = graph->num_nodes;
   header[2] = graph->num_edges;
 
@@ -301,5 +330,12 @@ void store_graph_binary(const char* filename, Graph graph) {
     exit(1);
   }
 
+  if (graph->outgoing_weights &&
+      fwrite(graph->outgoing_weights, sizeof(Weight), graph->num_edges,
+             output) != (size_t)graph->num_edges) {
+    fprintf(stderr, "Error writing weights.\n");
+    exit(1);
+  }
+
   fclose(output);
 }
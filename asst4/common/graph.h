@@ -2,6 +2,7 @@
 #define __GRAPH_H__
 
 using Vertex = int;
+using Weight = int;
 
 struct graph {
   // Number of edges in the graph
@@ -17,6 +18,11 @@ struct graph {
 
   int*    incoming_starts;
   Vertex* incoming_edges;
+
+  // Optional edge weights, parallel to outgoing_edges.  NULL for
+  // unweighted graphs.  Kept last so that the layout of the fields
+  // above matches the prebuilt reference objects (ref_bfs.o, ref_pr.a).
+  Weight* outgoing_weights;
 };
 
 using Graph = graph*;
@@ -28,6 +34,7 @@ static inline int num_edges(const Graph);
 static inline const Vertex* outgoing_begin(const Graph, Vertex);
 static inline const Vertex* outgoing_end(const Graph, Vertex);
 static inline int           outgoing_size(const Graph, Vertex);
+static inline const Weight* outgoing_weights_begin(const Graph, Vertex);
 
 static inline const Vertex* incoming_begin(const Graph, Vertex);
 static inline const Vertex* incoming_end(const Graph, Vertex);
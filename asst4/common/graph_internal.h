@@ -39,6 +39,13 @@ static int outgoing_size(const Graph g, Vertex v) {
   }
 }
 
+static inline const Weight* outgoing_weights_begin(const Graph g, Vertex v) {
+  REQUIRES(g != NULL);
+  REQUIRES(g->outgoing_weights != NULL);
+  REQUIRES(0 <= v && v < num_nodes(g));
+  return g->outgoing_weights + g->outgoing_starts[v];
+}
+
 static inline const Vertex* incoming_begin(const Graph g, Vertex v) {
   REQUIRES(g != NULL);
   REQUIRES(0 <= v && v < num_nodes(g));
@@ -0,0 +1,305 @@
+#include "graph_shards.h"
+
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/resource.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <string>
+#include <vector>
+
+#define GRAPH_HEADER_TOKEN          ((int)0xDEADBEEF)
+#define GRAPH_WEIGHTED_HEADER_TOKEN ((int)0xDEADBEFF)
+#define GRAPH_SHARDS_HEADER_TOKEN   ((int)0xDEADBE5D)
+
+// Edges read from the input graph per fread while partitioning
+#define PARTITION_CHUNK (1 << 20)
+
+// Most temporary shard files open at once while partitioning; more
+// shards than this are written in several rounds over the input
+#define MAX_SCRATCH_FILES 256
+
+static void read_ints(FILE* input, int* data, size_t count, const char* what) {
+  if (fread(data, sizeof(int), count, input) != count) {
+    fprintf(stderr, "Error reading %s.\n", what);
+    exit(1);
+  }
+}
+
+static void write_ints(FILE* output, const int* data, size_t count,
+                       const char* what) {
+  if (fwrite(data, sizeof(int), count, output) != count) {
+    fprintf(stderr, "Error writing %s.\n", what);
+    exit(1);
+  }
+}
+
+// Reads count bytes at offset, retrying short reads
+static void pread_all(int fd, void* data, long count, long offset,
+                      const char* what) {
+  char* dst = (char*)data;
+  while (count > 0) {
+    ssize_t n = pread(fd, dst, count, offset);
+    if (n <= 0) {
+      fprintf(stderr, "Error reading %s.\n", what);
+      exit(1);
+    }
+    dst += n;
+    offset += n;
+    count -= n;
+  }
+}
+
+// Calls f(source, destination) for every edge of the graph file, in
+// order, reading the edges PARTITION_CHUNK at a time.
+template <typename F>
+static void for_each_edge(FILE* input, long edges_offset, int num_nodes,
+                          int num_edges, const int* outgoing_starts, F f) {
+  std::vector<int> chunk(PARTITION_CHUNK);
+  fseek(input, edges_offset, SEEK_SET);
+
+  int src = 0;
+  for (int first = 0; first < num_edges; first += PARTITION_CHUNK) {
+    int count = std::min(PARTITION_CHUNK, num_edges - first);
+    read_ints(input, chunk.data(), count, "edges");
+    for (int i = 0; i < count; i++) {
+      while (src < num_nodes - 1 && outgoing_starts[src + 1] <= first + i)
+        src++;
+      f(src, chunk[i]);
+    }
+  }
+}
+
+void partition_graph_binary(const char* graph_filename,
+                            const char* shards_filename, int num_shards) {
+  FILE* input = fopen(graph_filename, "rb");
+  if (!input) {
+    fprintf(stderr, "Could not open: %s\n", graph_filename);
+    exit(1);
+  }
+
+  int header[4];
+  read_ints(input, header, 3, "header");
+  if (header[0] != GRAPH_HEADER_TOKEN &&
+      header[0] != GRAPH_WEIGHTED_HEADER_TOKEN) {
+    fprintf(stderr, "Invalid graph file header. File may be corrupt.\n");
+    exit(1);
+  }
+
+  int num_nodes = header[1];
+  int num_edges = header[2];
+  long edges_offset = sizeof(int) * (3L + num_nodes);
+  num_shards = std::max(1, std::min(num_shards, num_nodes));
+
+  int* outgoing_starts = (int*)malloc(sizeof(int) * num_nodes);
+  int* incoming_sizes = (int*)calloc(num_nodes, sizeof(int));
+  read_ints(input, outgoing_starts, num_nodes, "nodes");
+
+  // Pass 1: in-degrees, which give the size of every shard
+  for_each_edge(input, edges_offset, num_nodes, num_edges, outgoing_starts,
+                [&](int, int dst) { incoming_sizes[dst]++; });
+
+  // Cut the vertex range where the running size passes the next
+  // multiple of total / num_shards.  A vertex with a huge in-degree can
+  // swallow several cuts, in which case fewer shards come out.
+  std::vector<int> shard_starts(1, 0);
+  std::vector<int> shard_edges(1, 0);
+  long total = (long)num_nodes + num_edges;
+  long size = 0;
+  int edges = 0;
+  for (int v = 0; v < num_nodes; v++) {
+    int s = (int)shard_starts.size();
+    if (s < num_shards && v > shard_starts.back() &&
+        size >= total * s / num_shards) {
+      shard_starts.push_back(v);
+      shard_edges.push_back(edges);
+    }
+    size += 1 + incoming_sizes[v];
+    edges += incoming_sizes[v];
+  }
+  shard_starts.push_back(num_nodes);
+  shard_edges.push_back(num_edges);
+  num_shards = (int)shard_starts.size() - 1;
+
+  FILE* output = fopen(shards_filename, "wb");
+  if (!output) {
+    fprintf(stderr, "Could not open: %s\n", shards_filename);
+    exit(1);
+  }
+
+  header[0] = GRAPH_SHARDS_HEADER_TOKEN;
+  header[3] = num_shards;
+  write_ints(output, header, 4, "header");
+  write_ints(output, shard_starts.data(), num_shards + 1, "shard starts");
+  write_ints(output, shard_edges.data(), num_shards + 1, "shard edges");
+
+  std::vector<int> out_degrees(num_nodes);
+  for (int v = 0; v < num_nodes; v++) {
+    int end = (v == num_nodes - 1) ? num_edges : outgoing_starts[v + 1];
+    out_degrees[v] = end - outgoing_starts[v];
+  }
+  write_ints(output, out_degrees.data(), num_nodes, "out-degrees");
+
+  // Passes 2 and 3 run in rounds over as many shards as there are file
+  // descriptors to spare, keeping a few for stdio and the input/output.
+  struct rlimit limit;
+  int max_open = MAX_SCRATCH_FILES;
+  if (getrlimit(RLIMIT_NOFILE, &limit) == 0 && limit.rlim_cur != RLIM_INFINITY)
+    max_open = (int)std::min<rlim_t>(max_open, limit.rlim_cur);
+  max_open = std::max(1, max_open - 8);
+
+  std::vector<FILE*> scratch;
+  for (int lo = 0; lo < num_shards; lo += max_open) {
+    int hi = std::min(num_shards, lo + max_open);
+
+    // Pass 2: scatter the edges, as (destination, source) pairs, into
+    // one temporary file per shard of this round.  The files are
+    // unlinked as soon as they are open, so nothing is left behind on
+    // any exit path.  Sources come in increasing order, so every
+    // destination sees its sources in the same order as in
+    // build_incoming_edges.
+    scratch.assign(hi - lo, NULL);
+    for (int s = lo; s < hi; s++) {
+      std::string name = std::string(shards_filename) + ".tmp" + std::to_string(s);
+      scratch[s - lo] = fopen(name.c_str(), "w+b");
+      if (!scratch[s - lo]) {
+        fprintf(stderr, "Could not open: %s\n", name.c_str());
+        fclose(output);
+        unlink(shards_filename);
+        exit(1);
+      }
+      unlink(name.c_str());
+    }
+
+    int round_first = shard_starts[lo];
+    int round_end = shard_starts[hi];
+    for_each_edge(input, edges_offset, num_nodes, num_edges, outgoing_starts,
+                  [&](int src, int dst) {
+                    if (dst < round_first || dst >= round_end) return;
+                    int s = std::upper_bound(shard_starts.begin() + lo,
+                                             shard_starts.begin() + hi + 1, dst) -
+                            shard_starts.begin() - 1;
+                    int pair[2] = {dst, src};
+                    write_ints(scratch[s - lo], pair, 2, "scratch edges");
+                  });
+
+    // Pass 3: sort each shard by destination (a stable counting sort,
+    // so the order of the sources is kept) and append it to the output
+    for (int s = lo; s < hi; s++) {
+      int first = shard_starts[s];
+      int nodes = shard_starts[s + 1] - first;
+      int count = shard_edges[s + 1] - shard_edges[s];
+
+      std::vector<int> pairs(2L * count);
+      std::vector<int> starts(nodes), cursor(nodes);
+      std::vector<Vertex> sources(count);
+
+      rewind(scratch[s - lo]);
+      read_ints(scratch[s - lo], pairs.data(), pairs.size(), "scratch edges");
+      fclose(scratch[s - lo]);
+
+      int offset = 0;
+      for (int i = 0; i < nodes; i++) {
+        starts[i] = cursor[i] = offset;
+        offset += incoming_sizes[first + i];
+      }
+      for (int i = 0; i < count; i++)
+        sources[cursor[pairs[2L * i] - first]++] = pairs[2L * i + 1];
+
+      write_ints(output, starts.data(), nodes, "shard nodes");
+      write_ints(output, sources.data(), count, "shard edges");
+    }
+  }
+
+  fclose(input);
+  fclose(output);
+  free(outgoing_starts);
+  free(incoming_sizes);
+}
+
+GraphShards open_graph_shards(const char* filename) {
+  int fd = open(filename, O_RDONLY);
+  if (fd < 0) {
+    fprintf(stderr, "Could not open: %s\n", filename);
+    exit(1);
+  }
+  // Shards are read front to back, once per sweep
+  posix_fadvise(fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+
+  int header[4];
+  pread_all(fd, header, sizeof(header), 0, "header");
+  if (header[0] != GRAPH_SHARDS_HEADER_TOKEN) {
+    fprintf(stderr, "Invalid shard file header. File may be corrupt.\n");
+    exit(1);
+  }
+
+  graph_shards* shards = (graph_shards*)malloc(sizeof(graph_shards));
+  shards->num_nodes = header[1];
+  shards->num_edges = header[2];
+  shards->num_shards = header[3];
+  shards->fd = fd;
+
+  int num_shards = shards->num_shards;
+  shards->shard_starts = (int*)malloc(sizeof(int) * (num_shards + 1));
+  shards->shard_edges = (int*)malloc(sizeof(int) * (num_shards + 1));
+  shards->outgoing_sizes = (int*)malloc(sizeof(int) * shards->num_nodes);
+
+  long offset = sizeof(header);
+  pread_all(fd, shards->shard_starts, sizeof(int) * (num_shards + 1), offset,
+            "shard starts");
+  offset += sizeof(int) * (num_shards + 1);
+  pread_all(fd, shards->shard_edges, sizeof(int) * (num_shards + 1), offset,
+            "shard edges");
+  offset += sizeof(int) * (num_shards + 1);
+  pread_all(fd, shards->outgoing_sizes, sizeof(int) * (long)shards->num_nodes,
+            offset, "out-degrees");
+  shards->data_offset = offset + sizeof(int) * (long)shards->num_nodes;
+
+  return shards;
+}
+
+void close_graph_shards(GraphShards shards) {
+  close(shards->fd);
+  free(shards->shard_starts);
+  free(shards->shard_edges);
+  free(shards->outgoing_sizes);
+  free(shards);
+}
+
+long shard_bytes(const GraphShards shards, int s) {
+  long nodes = shards->shard_starts[s + 1] - shards->shard_starts[s];
+  long edges = shards->shard_edges[s + 1] - shards->shard_edges[s];
+  return sizeof(int) * (nodes + edges);
+}
+
+// A shard is read into one block: its incoming_starts followed by its
+// incoming_edges.
+void shard_init(const GraphShards shards, graph_shard* shard) {
+  long max_bytes = 0;
+  for (int s = 0; s < shards->num_shards; s++)
+    max_bytes = std::max(max_bytes, shard_bytes(shards, s));
+
+  shard->id = -1;
+  shard->first_node = shard->num_nodes = shard->num_edges = 0;
+  shard->incoming_starts = (int*)malloc(std::max(max_bytes, 1L));
+  shard->incoming_edges = shard->incoming_starts;
+}
+
+void shard_free(graph_shard* shard) {
+  free(shard->incoming_starts);
+}
+
+void read_shard(const GraphShards shards, int s, graph_shard* shard) {
+  long offset = shards->data_offset +
+                sizeof(int) * ((long)shards->shard_starts[s] + shards->shard_edges[s]);
+  pread_all(shards->fd, shard->incoming_starts, shard_bytes(shards, s), offset,
+            "shard");
+
+  shard->id = s;
+  shard->first_node = shards->shard_starts[s];
+  shard->num_nodes = shards->shard_starts[s + 1] - shard->first_node;
+  shard->num_edges = shards->shard_edges[s + 1] - shards->shard_edges[s];
+  shard->incoming_edges = shard->incoming_starts + shard->num_nodes;
+}
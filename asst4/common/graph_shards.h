@@ -0,0 +1,89 @@
+#ifndef __GRAPH_SHARDS_H__
+#define __GRAPH_SHARDS_H__
+
+#include "graph.h"
+
+// On-disk layout for processing graphs that do not fit in memory,
+// in the style of GraphChi's shards: the vertices are split into
+// intervals of consecutive ids, and shard s holds the incoming edges of
+// the vertices in interval s as a small CSR of its own.  A shard is one
+// contiguous block of the file, so it can be brought in with a single
+// sequential read, and only one or two of them need to be in memory at
+// a time next to the per-vertex arrays.
+//
+// File layout (all ints unless noted):
+//
+//   header[4]                 token, num_nodes, num_edges, num_shards
+//   shard_starts[num_shards+1]  first vertex of each shard
+//   shard_edges[num_shards+1]   index of the first edge of each shard
+//   outgoing_sizes[num_nodes]   out-degree of every vertex
+//   shard 0 .. num_shards-1:
+//     incoming_starts[shard nodes]  relative to the shard's first edge
+//     incoming_edges[shard edges]   source vertices
+//
+// The incoming edges of a vertex come in the same order as in
+// graph::incoming_edges, so gathers over them add up in the same order.
+
+struct graph_shards {
+  int num_nodes;
+  int num_edges;
+  int num_shards;
+
+  int* shard_starts;
+  int* shard_edges;
+  int* outgoing_sizes;
+
+  // Open file and offset of shard 0
+  int  fd;
+  long data_offset;
+};
+
+// One shard in memory.  Buffers are sized for the largest shard of a
+// file, so the same one can be reused for every shard.
+struct graph_shard {
+  int id;
+  int first_node;
+  int num_nodes;
+  int num_edges;
+
+  int*    incoming_starts;
+  Vertex* incoming_edges;
+};
+
+using GraphShards = graph_shards*;
+
+// Splits the binary graph in graph_filename into num_shards shards with
+// about the same number of bytes each, stored in shards_filename.  Only
+// the per-vertex arrays and one shard are held in memory; the edges are
+// scattered through temporary files next to shards_filename, a bounded
+// number of shards at a time.
+void partition_graph_binary(const char* graph_filename,
+                            const char* shards_filename, int num_shards);
+
+GraphShards open_graph_shards(const char* filename);
+void        close_graph_shards(GraphShards);
+
+// Shard buffers
+void shard_init(const GraphShards, graph_shard* shard);
+void shard_free(graph_shard* shard);
+
+// Reads shard s into shard (sized by shard_init)
+void read_shard(const GraphShards, int s, graph_shard* shard);
+
+// Bytes in the file taken by shard s
+long shard_bytes(const GraphShards, int s);
+
+static inline const Vertex* shard_incoming_begin(const graph_shard* shard,
+                                                 Vertex v) {
+  return shard->incoming_edges + shard->incoming_starts[v - shard->first_node];
+}
+
+static inline const Vertex* shard_incoming_end(const graph_shard* shard,
+                                               Vertex v) {
+  int local = v - shard->first_node;
+  int offset = (local == shard->num_nodes - 1) ? shard->num_edges
+                                               : shard->incoming_starts[local + 1];
+  return shard->incoming_edges + offset;
+}
+
+#endif /* __GRAPH_SHARDS_H__ */
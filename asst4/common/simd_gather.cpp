@@ -0,0 +1,234 @@
+#include "simd_gather.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(__x86_64__)
+#include <immintrin.h>
+#endif
+
+static double gather_sum_scalar(const double* values, const Vertex* idx, int n) {
+  double sum = 0.0;
+  for (int i = 0; i < n; i++) sum += values[idx[i]];
+  return sum;
+}
+
+static double gather_sum_float_scalar(const float* values, const Vertex* idx, int n) {
+  double sum = 0.0;
+  for (int i = 0; i < n; i++) sum += values[idx[i]];
+  return sum;
+}
+
+static int find_first_scalar(const int* values, const Vertex* idx, int n, int key) {
+  for (int i = 0; i < n; i++)
+    if (values[idx[i]] == key) return i;
+  return n;
+}
+
+#if defined(__x86_64__)
+
+// The bottom-up search usually stops within the first few neighbors,
+// where a full-width gather would mostly fetch values it never looks
+// at, so the SIMD versions of find_first check this many neighbors one
+// by one first.
+#define FIND_FIRST_SCALAR_PREFIX 4
+
+// Two accumulators of 4 lanes each, then a masked gather for the
+// last (n % 4) neighbors.
+__attribute__((target("avx2")))
+static double gather_sum_avx2(const double* values, const Vertex* idx, int n) {
+  __m256d acc0 = _mm256_setzero_pd();
+  __m256d acc1 = _mm256_setzero_pd();
+  int i = 0;
+  for (; i + 8 <= n; i += 8) {
+    __m128i i0 = _mm_loadu_si128((const __m128i*)(idx + i));
+    __m128i i1 = _mm_loadu_si128((const __m128i*)(idx + i + 4));
+    acc0 = _mm256_add_pd(acc0, _mm256_i32gather_pd(values, i0, 8));
+    acc1 = _mm256_add_pd(acc1, _mm256_i32gather_pd(values, i1, 8));
+  }
+  for (; i < n; i += 4) {
+    __m128i lanes = _mm_cmpgt_epi32(_mm_set1_epi32(n - i), _mm_setr_epi32(0, 1, 2, 3));
+    __m128i ix = _mm_maskload_epi32(idx + i, lanes);
+    __m256d mask = _mm256_castsi256_pd(_mm256_cvtepi32_epi64(lanes));
+    acc0 = _mm256_add_pd(acc0, _mm256_mask_i32gather_pd(_mm256_setzero_pd(), values, ix, mask, 8));
+  }
+  __m256d acc = _mm256_add_pd(acc0, acc1);
+  __m128d half = _mm_add_pd(_mm256_castpd256_pd128(acc), _mm256_extractf128_pd(acc, 1));
+  return _mm_cvtsd_f64(_mm_add_sd(half, _mm_unpackhi_pd(half, half)));
+}
+
+// One gather of 8 floats, widened to double in two halves
+__attribute__((target("avx2")))
+static double gather_sum_float_avx2(const float* values, const Vertex* idx, int n) {
+  __m256d acc0 = _mm256_setzero_pd();
+  __m256d acc1 = _mm256_setzero_pd();
+  int i = 0;
+  for (; i + 8 <= n; i += 8) {
+    __m256i ix = _mm256_loadu_si256((const __m256i*)(idx + i));
+    __m256 found = _mm256_i32gather_ps(values, ix, 4);
+    acc0 = _mm256_add_pd(acc0, _mm256_cvtps_pd(_mm256_castps256_ps128(found)));
+    acc1 = _mm256_add_pd(acc1, _mm256_cvtps_pd(_mm256_extractf128_ps(found, 1)));
+  }
+  if (i < n) {
+    __m128i lanes = _mm_cmpgt_epi32(_mm_set1_epi32(n - i), _mm_setr_epi32(0, 1, 2, 3));
+    __m128i ix = _mm_maskload_epi32(idx + i, lanes);
+    __m128 found = _mm_mask_i32gather_ps(_mm_setzero_ps(), values, ix, _mm_castsi128_ps(lanes), 4);
+    acc0 = _mm256_add_pd(acc0, _mm256_cvtps_pd(found));
+    if (i + 4 < n) {
+      lanes = _mm_cmpgt_epi32(_mm_set1_epi32(n - i - 4), _mm_setr_epi32(0, 1, 2, 3));
+      ix = _mm_maskload_epi32(idx + i + 4, lanes);
+      found = _mm_mask_i32gather_ps(_mm_setzero_ps(), values, ix, _mm_castsi128_ps(lanes), 4);
+      acc1 = _mm256_add_pd(acc1, _mm256_cvtps_pd(found));
+    }
+  }
+  __m256d acc = _mm256_add_pd(acc0, acc1);
+  __m128d half = _mm_add_pd(_mm256_castpd256_pd128(acc), _mm256_extractf128_pd(acc, 1));
+  return _mm_cvtsd_f64(_mm_add_sd(half, _mm_unpackhi_pd(half, half)));
+}
+
+__attribute__((target("avx2")))
+static int find_first_avx2(const int* values, const Vertex* idx, int n, int key) {
+  int i = 0;
+  for (; i < n && i < FIND_FIRST_SCALAR_PREFIX; i++)
+    if (values[idx[i]] == key) return i;
+
+  const __m256i keys = _mm256_set1_epi32(key);
+  for (; i + 8 <= n; i += 8) {
+    __m256i ix = _mm256_loadu_si256((const __m256i*)(idx + i));
+    __m256i eq = _mm256_cmpeq_epi32(_mm256_i32gather_epi32(values, ix, 4), keys);
+    int hits = _mm256_movemask_ps(_mm256_castsi256_ps(eq));
+    if (hits) return i + __builtin_ctz(hits);
+  }
+  if (i < n) {
+    __m256i lanes = _mm256_cmpgt_epi32(_mm256_set1_epi32(n - i),
+                                       _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7));
+    __m256i ix = _mm256_maskload_epi32(idx + i, lanes);
+    __m256i found = _mm256_mask_i32gather_epi32(_mm256_setzero_si256(), values, ix, lanes, 4);
+    __m256i eq = _mm256_and_si256(_mm256_cmpeq_epi32(found, keys), lanes);
+    int hits = _mm256_movemask_ps(_mm256_castsi256_ps(eq));
+    if (hits) return i + __builtin_ctz(hits);
+  }
+  return n;
+}
+
+__attribute__((target("avx512f")))
+static double gather_sum_avx512(const double* values, const Vertex* idx, int n) {
+  __m512d acc0 = _mm512_setzero_pd();
+  __m512d acc1 = _mm512_setzero_pd();
+  int i = 0;
+  for (; i + 16 <= n; i += 16) {
+    __m512i ix = _mm512_loadu_si512(idx + i);
+    acc0 = _mm512_add_pd(acc0, _mm512_i32gather_pd(_mm512_castsi512_si256(ix), values, 8));
+    acc1 = _mm512_add_pd(acc1, _mm512_i32gather_pd(_mm512_extracti64x4_epi64(ix, 1), values, 8));
+  }
+  for (; i < n; i += 8) {
+    __mmask8 lanes = n - i >= 8 ? 0xff : (1u << (n - i)) - 1;
+    __m512i ix = _mm512_maskz_loadu_epi32(lanes, idx + i);
+    acc0 = _mm512_add_pd(acc0, _mm512_mask_i32gather_pd(_mm512_setzero_pd(), lanes,
+                                                         _mm512_castsi512_si256(ix), values, 8));
+  }
+  return _mm512_reduce_add_pd(_mm512_add_pd(acc0, acc1));
+}
+
+__attribute__((target("avx512f")))
+static double gather_sum_float_avx512(const float* values, const Vertex* idx, int n) {
+  __m512d acc0 = _mm512_setzero_pd();
+  __m512d acc1 = _mm512_setzero_pd();
+  for (int i = 0; i < n; i += 16) {
+    __mmask16 lanes = n - i >= 16 ? 0xffff : (1u << (n - i)) - 1;
+    __m512i ix = _mm512_maskz_loadu_epi32(lanes, idx + i);
+    __m512 found = _mm512_mask_i32gather_ps(_mm512_setzero_ps(), lanes, ix, values, 4);
+    __m512d high = _mm512_castps_pd(found);
+    acc0 = _mm512_add_pd(acc0, _mm512_cvtps_pd(_mm512_castps512_ps256(found)));
+    acc1 = _mm512_add_pd(acc1, _mm512_cvtps_pd(_mm256_castpd_ps(_mm512_extractf64x4_pd(high, 1))));
+  }
+  return _mm512_reduce_add_pd(_mm512_add_pd(acc0, acc1));
+}
+
+__attribute__((target("avx512f")))
+static int find_first_avx512(const int* values, const Vertex* idx, int n, int key) {
+  int i = 0;
+  for (; i < n && i < FIND_FIRST_SCALAR_PREFIX; i++)
+    if (values[idx[i]] == key) return i;
+
+  const __m512i keys = _mm512_set1_epi32(key);
+  for (; i < n; i += 16) {
+    __mmask16 lanes = n - i >= 16 ? 0xffff : (1u << (n - i)) - 1;
+    __m512i ix = _mm512_maskz_loadu_epi32(lanes, idx + i);
+    __m512i found = _mm512_mask_i32gather_epi32(_mm512_setzero_si512(), lanes, ix, values, 4);
+    __mmask16 hits = _mm512_mask_cmpeq_epi32_mask(lanes, found, keys);
+    if (hits) return i + __builtin_ctz(hits);
+  }
+  return n;
+}
+
+#endif  // __x86_64__
+
+static simd_isa simd_supported() {
+#if defined(__x86_64__)
+  __builtin_cpu_init();
+  if (__builtin_cpu_supports("avx512f")) return SIMD_AVX512;
+  if (__builtin_cpu_supports("avx2")) return SIMD_AVX2;
+#endif
+  return SIMD_SCALAR;
+}
+
+// SIMD_ISA from the environment, or -1 if it is not set
+static int simd_forced() {
+  const char* forced = getenv("SIMD_ISA");
+  if (!forced) return -1;
+  if (!strcmp(forced, "scalar")) return SIMD_SCALAR;
+  if (!strcmp(forced, "avx2")) return SIMD_AVX2;
+  if (!strcmp(forced, "avx512")) return SIMD_AVX512;
+  return -1;
+}
+
+simd_isa simd_detect() {
+  simd_isa supported = simd_supported();
+  int forced = simd_forced();
+  // Never hand out a version the CPU would fault on
+  if (forced >= 0 && forced < supported) return (simd_isa)forced;
+  return supported;
+}
+
+const char* simd_isa_name(simd_isa isa) {
+  switch (isa) {
+    case SIMD_AVX2:
+      return "avx2";
+    case SIMD_AVX512:
+      return "avx512";
+    default:
+      return "scalar";
+  }
+}
+
+gather_sum_fn gather_sum_for(simd_isa isa) {
+#if defined(__x86_64__)
+  if (isa == SIMD_AVX512) return gather_sum_avx512;
+  if (isa == SIMD_AVX2) return gather_sum_avx2;
+#endif
+  return gather_sum_scalar;
+}
+
+gather_sum_float_fn gather_sum_float_for(simd_isa isa) {
+#if defined(__x86_64__)
+  if (isa == SIMD_AVX512) return gather_sum_float_avx512;
+  if (isa == SIMD_AVX2) return gather_sum_float_avx2;
+#endif
+  return gather_sum_float_scalar;
+}
+
+find_first_fn find_first_for(simd_isa isa) {
+#if defined(__x86_64__)
+  if (isa == SIMD_AVX512) return find_first_avx512;
+  if (isa == SIMD_AVX2) return find_first_avx2;
+#endif
+  return find_first_scalar;
+}
+
+gather_sum_fn gather_sum = gather_sum_for(simd_detect());
+gather_sum_float_fn gather_sum_float = gather_sum_float_for(simd_detect());
+// On r16 the gathered find_first runs at 0.92-0.96x of the scalar loop
+// (gatherBench, 10% hits): the search stops within a few neighbors,
+// before a gather pays off.  So it is only used when SIMD_ISA asks.
+find_first_fn find_first = find_first_for(simd_forced() >= 0 ? simd_detect() : SIMD_SCALAR);
@@ -0,0 +1,41 @@
+#ifndef __SIMD_GATHER_H__
+#define __SIMD_GATHER_H__
+
+#include "graph.h"
+
+// Vectorized kernels for the sparse edge loops.  Each kernel has a
+// scalar version and, on x86-64, AVX2 and AVX-512 versions built with
+// per-function target attributes, so the rest of the program can stay
+// compiled for the baseline ISA.  The best version the CPU supports is
+// picked at startup, except for find_first, which stays scalar; set
+// SIMD_ISA=scalar|avx2|avx512 in the environment to force one (capped
+// at what the CPU supports).
+
+enum simd_isa { SIMD_SCALAR, SIMD_AVX2, SIMD_AVX512 };
+
+// Returns sum of values[idx[i]] for 0 <= i < n
+typedef double (*gather_sum_fn)(const double* values, const Vertex* idx, int n);
+
+// Same, for float values, summed in double
+typedef double (*gather_sum_float_fn)(const float* values, const Vertex* idx, int n);
+
+// Returns the first i < n with values[idx[i]] == key, or n if none
+typedef int (*find_first_fn)(const int* values, const Vertex* idx, int n,
+                             int key);
+
+// Best ISA this CPU supports, or SIMD_ISA if that is lower
+simd_isa simd_detect();
+const char* simd_isa_name(simd_isa isa);
+
+// The versions for a given ISA; only call them if simd_detect() is at
+// least isa
+gather_sum_fn gather_sum_for(simd_isa isa);
+gather_sum_float_fn gather_sum_float_for(simd_isa isa);
+find_first_fn find_first_for(simd_isa isa);
+
+// Dispatched versions
+extern gather_sum_fn gather_sum;
+extern gather_sum_float_fn gather_sum_float;
+extern find_first_fn find_first;
+
+#endif /* __SIMD_GATHER_H__ */
@@ -0,0 +1,274 @@
+#include "components.h"
+
+#include <omp.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <random>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "../common/graph.h"
+
+#define UNASSIGNED      -1
+#define CHUNK           500
+#define NEIGHBOR_ROUNDS 2
+#define NUM_SAMPLES     1024
+
+// Lowers *addr to val if val is smaller.  Returns true if this call
+// changed the stored value.
+static inline bool atomic_min(int *addr, int val) {
+  int old = *addr;
+  while (val < old) {
+    if (__sync_bool_compare_and_swap(addr, old, val)) return true;
+    old = *addr;
+  }
+  return false;
+}
+
+// Expand one level of a frontier-based traversal.  For every vertex u
+// in frontier, visit(u, w) is called for each neighbor w (outgoing
+// neighbors if forward, incoming ones otherwise); w is appended to
+// next iff visit returns true.  visit must return true at most once per
+// w for a given level.  Returns the size of the next frontier.
+template <typename Visit>
+static int expand(Graph g, const int *frontier, int count, int *next,
+                  bool forward, Visit visit) {
+  int next_count = 0;
+#pragma omp parallel
+  {
+    std::vector<int> local;
+
+#pragma omp for schedule(dynamic, 64) nowait
+    for (int i = 0; i < count; i++) {
+      int u = frontier[i];
+      const Vertex *begin = forward ? outgoing_begin(g, u) : incoming_begin(g, u);
+      const Vertex *end = forward ? outgoing_end(g, u) : incoming_end(g, u);
+      for (const Vertex *v = begin; v != end; v++) {
+        if (visit(u, *v)) local.push_back(*v);
+      }
+    }
+
+    int offset = __sync_fetch_and_add(&next_count, (int) local.size());
+    memcpy(next + offset, local.data(), local.size() * sizeof(int));
+  }
+  return next_count;
+}
+
+// Gather every vertex v for which pred(v) holds into out.  Returns the
+// number of vertices gathered.
+template <typename Pred>
+static int collect(Graph g, int *out, Pred pred) {
+  int count = 0;
+#pragma omp parallel
+  {
+    std::vector<int> local;
+
+#pragma omp for schedule(dynamic, CHUNK) nowait
+    for (int v = 0; v < g->num_nodes; v++)
+      if (pred(v)) local.push_back(v);
+
+    int offset = __sync_fetch_and_add(&count, (int) local.size());
+    memcpy(out + offset, local.data(), local.size() * sizeof(int));
+  }
+  return count;
+}
+
+// Hook the trees containing u and v together, always pointing the
+// larger root at the smaller one (Shiloach-Vishkin style).
+static void link(Vertex u, Vertex v, int *comp) {
+  int p1 = comp[u];
+  int p2 = comp[v];
+  while (p1 != p2) {
+    int high = p1 > p2 ? p1 : p2;
+    int low = p1 + (p2 - high);
+    int p_high = comp[high];
+    // Either someone already hooked high onto low, or we do it now
+    if (p_high == low ||
+        (p_high == high && __sync_bool_compare_and_swap(comp + high, high, low)))
+      break;
+    p1 = comp[comp[high]];
+    p2 = comp[low];
+  }
+}
+
+static void compress(Graph g, int *comp) {
+#pragma omp parallel for schedule(dynamic, CHUNK)
+  for (int v = 0; v < g->num_nodes; v++) {
+    while (comp[v] != comp[comp[v]]) comp[v] = comp[comp[v]];
+  }
+}
+
+// Estimate the largest intermediate component by sampling.
+static int sample_frequent_element(Graph g, const int *comp) {
+  std::unordered_map<int, int> counts;
+  std::mt19937 gen(27491095);
+  std::uniform_int_distribution<int> distribution(0, g->num_nodes - 1);
+
+  for (int i = 0; i < NUM_SAMPLES; i++) counts[comp[distribution(gen)]]++;
+
+  int most_frequent = comp[0];
+  int max_count = 0;
+  for (auto &kv : counts) {
+    if (kv.second > max_count) {
+      most_frequent = kv.first;
+      max_count = kv.second;
+    }
+  }
+  return most_frequent;
+}
+
+void cc_afforest(Graph g, int *labels) {
+  int *comp = labels;
+
+#pragma omp parallel for schedule(dynamic, CHUNK)
+  for (int v = 0; v < g->num_nodes; v++) comp[v] = v;
+
+  // Link along the first few outgoing edges of every vertex.  This is
+  // usually enough to grow the giant component almost completely.
+  for (int r = 0; r < NEIGHBOR_ROUNDS; r++) {
+#pragma omp parallel for schedule(dynamic, CHUNK)
+    for (int u = 0; u < g->num_nodes; u++) {
+      if (r < outgoing_size(g, u)) link(u, outgoing_begin(g, u)[r], comp);
+    }
+    compress(g, comp);
+  }
+
+  int c = sample_frequent_element(g, comp);
+
+  // Finish the remaining edges, skipping vertices that are already in
+  // the giant component.  Every edge with at least one endpoint outside
+  // of c is still seen: from its source via the outgoing list or from
+  // its destination via the incoming list.
+#pragma omp parallel for schedule(dynamic, CHUNK)
+  for (int u = 0; u < g->num_nodes; u++) {
+    if (comp[u] == c) continue;
+
+    const Vertex *out_begin = outgoing_begin(g, u);
+    const Vertex *out_end = outgoing_end(g, u);
+    for (const Vertex *v = out_begin + NEIGHBOR_ROUNDS; v < out_end; v++)
+      link(u, *v, comp);
+
+    const Vertex *in_begin = incoming_begin(g, u);
+    const Vertex *in_end = incoming_end(g, u);
+    for (const Vertex *v = in_begin; v != in_end; v++) link(u, *v, comp);
+  }
+
+  compress(g, comp);
+}
+
+void scc_coloring(Graph g, int *labels) {
+  int numNodes = num_nodes(g);
+
+  int *frontier = (int *) malloc(sizeof(int) * numNodes);
+  int *next = (int *) malloc(sizeof(int) * numNodes);
+  int *color = (int *) malloc(sizeof(int) * numNodes);
+  int *flags = (int *) malloc(sizeof(int) * numNodes);
+
+  // Trim: a vertex without incoming or without outgoing edges is a
+  // strongly connected component of its own.
+#pragma omp parallel for schedule(dynamic, CHUNK)
+  for (int v = 0; v < numNodes; v++) {
+    flags[v] = 0;
+    labels[v] = (incoming_size(g, v) == 0 || outgoing_size(g, v) == 0)
+                    ? v
+                    : UNASSIGNED;
+  }
+
+  // Forward-backward from the vertex with the largest in * out degree
+  // product.  On real-world graphs this peels off the giant SCC in two
+  // traversals.
+  long best_degree = 0;
+  int pivot = UNASSIGNED;
+#pragma omp parallel
+  {
+    long local_degree = 0;
+    int local_pivot = UNASSIGNED;
+#pragma omp for schedule(dynamic, CHUNK) nowait
+    for (int v = 0; v < numNodes; v++) {
+      long degree = (long) incoming_size(g, v) * outgoing_size(g, v);
+      if (labels[v] == UNASSIGNED && degree > local_degree) {
+        local_degree = degree;
+        local_pivot = v;
+      }
+    }
+#pragma omp critical
+    {
+      if (local_degree > best_degree ||
+          (local_degree == best_degree && local_pivot < pivot)) {
+        best_degree = local_degree;
+        pivot = local_pivot;
+      }
+    }
+  }
+
+  if (pivot != UNASSIGNED) {
+    int count = 1;
+    frontier[0] = pivot;
+    flags[pivot] = 1;
+    while (count != 0) {
+      count = expand(g, frontier, count, next, true, [&](int, int w) {
+        return labels[w] == UNASSIGNED && flags[w] == 0 &&
+               __sync_bool_compare_and_swap(flags + w, 0, 1);
+      });
+      std::swap(frontier, next);
+    }
+
+    count = 1;
+    frontier[0] = pivot;
+    labels[pivot] = pivot;
+    while (count != 0) {
+      count = expand(g, frontier, count, next, false, [&](int, int w) {
+        return flags[w] == 1 && labels[w] == UNASSIGNED &&
+               __sync_bool_compare_and_swap(labels + w, UNASSIGNED, pivot);
+      });
+      std::swap(frontier, next);
+    }
+  }
+
+  // Coloring for everything that is left.  Each round propagates the
+  // minimum vertex id forward, so color[v] becomes the smallest id that
+  // can reach v.  Every vertex r with color[r] == r then owns the SCC of
+  // all vertices of color r that reach r, found by a backward traversal
+  // restricted to that color.
+  auto unassigned = [&](int v) { return labels[v] == UNASSIGNED; };
+  int remaining = collect(g, frontier, unassigned);
+  while (remaining != 0) {
+#pragma omp parallel for schedule(dynamic, CHUNK)
+    for (int i = 0; i < remaining; i++) color[frontier[i]] = frontier[i];
+
+    int count = remaining;
+    while (count != 0) {
+#pragma omp parallel for schedule(dynamic, CHUNK)
+      for (int i = 0; i < count; i++) flags[frontier[i]] = 0;
+
+      count = expand(g, frontier, count, next, true, [&](int u, int w) {
+        return labels[w] == UNASSIGNED && atomic_min(color + w, color[u]) &&
+               __sync_bool_compare_and_swap(flags + w, 0, 1);
+      });
+      std::swap(frontier, next);
+    }
+
+    count = collect(g, frontier, [&](int v) {
+      return labels[v] == UNASSIGNED && color[v] == v;
+    });
+#pragma omp parallel for schedule(dynamic, CHUNK)
+    for (int i = 0; i < count; i++) labels[frontier[i]] = frontier[i];
+
+    while (count != 0) {
+      count = expand(g, frontier, count, next, false, [&](int u, int w) {
+        return labels[w] == UNASSIGNED && color[w] == color[u] &&
+               __sync_bool_compare_and_swap(labels + w, UNASSIGNED, color[u]);
+      });
+      std::swap(frontier, next);
+    }
+
+    remaining = collect(g, frontier, unassigned);
+  }
+
+  free(frontier);
+  free(next);
+  free(color);
+  free(flags);
+}
@@ -0,0 +1,31 @@
+#ifndef __COMPONENTS_H__
+#define __COMPONENTS_H__
+
+#include "common/graph.h"
+
+// Both kernels write one label per vertex into `labels` (length
+// num_nodes(g)).  Two vertices get the same label iff they are in the
+// same component; the label value itself is the id of some vertex in
+// the component.
+
+// Weakly connected components (edge directions are ignored), computed
+// with Afforest-style subgraph sampling and Shiloach-Vishkin hooking.
+void cc_afforest(Graph g, int* labels);
+
+// Strongly connected components, computed with trimming, one
+// forward-backward sweep from a high degree pivot, and coloring for the
+// remaining vertices.
+void scc_coloring(Graph g, int* labels);
+
+// Serial reference implementations used by the correctness checks.
+void reference_cc(Graph g, int* labels);
+void reference_scc(Graph g, int* labels);
+
+// Returns true iff `ref` and `stu` describe the same partition of the
+// vertex set (labels are allowed to differ by a renaming).
+bool same_components(Graph g, const int* ref, const int* stu);
+
+// Number of distinct components described by `labels`.
+int count_components(Graph g, const int* labels);
+
+#endif /* __COMPONENTS_H__ */
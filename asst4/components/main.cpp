@@ -0,0 +1,140 @@
+#include <omp.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "common/CycleTimer.h"
+#include "common/benchmark.h"
+#include "common/graph.h"
+#include "components.h"
+
+int main(int argc, char** argv) {
+  if (argc < 2) {
+    std::cerr << "Usage: <path/to/graph/file> [num_threads]\n";
+    std::cerr
+        << "  To run results for all thread counts: <path/to/graph/file>\n";
+    std::cerr << "  Run with a certain number of threads: "
+                 "<path/to/graph/file> <num_threads>\n";
+    exit(1);
+  }
+
+  int thread_count = -1;
+  if (argc == 3) {
+    thread_count = atoi(argv[2]);
+  }
+
+  printf("----------------------------------------------------------\n");
+  printf("Max system threads = %d\n", omp_get_max_threads());
+  if (thread_count > 0) {
+    thread_count = std::min(thread_count, omp_get_max_threads());
+    printf("Running with %d threads\n", thread_count);
+  }
+  printf("----------------------------------------------------------\n");
+
+  printf("Loading graph...\n");
+  Graph g = load_graph_binary(argv[1]);
+  printf("\n");
+  printf("Graph stats:\n");
+  printf("  Edges: %d\n", g->num_edges);
+  printf("  Nodes: %d\n", g->num_nodes);
+
+  std::vector<int> num_threads;
+  if (thread_count <= -1) {
+    num_threads = bench_thread_counts(omp_get_max_threads());
+  } else {
+    num_threads.push_back(thread_count);
+  }
+  int n_usage = num_threads.size();
+
+  int* ref_cc = (int*)malloc(sizeof(int) * g->num_nodes);
+  int* ref_scc = (int*)malloc(sizeof(int) * g->num_nodes);
+  int* sol_cc = (int*)malloc(sizeof(int) * g->num_nodes);
+  int* sol_scc = (int*)malloc(sizeof(int) * g->num_nodes);
+
+  // The references are serial, so they only need to run once.
+  double start = CycleTimer::currentSeconds();
+  reference_cc(g, ref_cc);
+  double ref_cc_time = CycleTimer::currentSeconds() - start;
+
+  start = CycleTimer::currentSeconds();
+  reference_scc(g, ref_scc);
+  double ref_scc_time = CycleTimer::currentSeconds() - start;
+
+  printf("  Weakly connected components:   %d\n",
+         count_components(g, ref_cc));
+  printf("  Strongly connected components: %d\n",
+         count_components(g, ref_scc));
+
+  double cc_base, scc_base;
+  double cc_time, scc_time;
+
+  std::stringstream timing;
+  std::stringstream relative_timing;
+
+  bool cc_check = true, scc_check = true;
+
+  timing << "Threads  WCC               SCC\n";
+  relative_timing << "Threads       WCC                SCC\n";
+
+  for (int i = 0; i < n_usage; i++) {
+    printf("----------------------------------------------------------\n");
+    std::cout << "Running with " << num_threads[i] << " threads" << std::endl;
+    omp_set_num_threads(num_threads[i]);
+
+    start = CycleTimer::currentSeconds();
+    cc_afforest(g, sol_cc);
+    cc_time = CycleTimer::currentSeconds() - start;
+
+    std::cout << "Testing Correctness of WCC\n";
+    if (!same_components(g, ref_cc, sol_cc)) cc_check = false;
+
+    start = CycleTimer::currentSeconds();
+    scc_coloring(g, sol_scc);
+    scc_time = CycleTimer::currentSeconds() - start;
+
+    std::cout << "Testing Correctness of SCC\n";
+    if (!same_components(g, ref_scc, sol_scc)) scc_check = false;
+
+    if (i == 0) {
+      cc_base  = cc_time;
+      scc_base = scc_time;
+    }
+
+    char buf[1024];
+    char relative_buf[1024];
+
+    sprintf(buf, "%4d:    %.4f (%.2fx)    %.4f (%.2fx)\n", num_threads[i],
+            cc_time, cc_base / cc_time, scc_time, scc_base / scc_time);
+    sprintf(relative_buf, "%4d:   %14.2f     %14.2f\n", num_threads[i],
+            ref_cc_time / cc_time, ref_scc_time / scc_time);
+
+    timing << buf;
+    relative_timing << relative_buf;
+  }
+
+  printf("----------------------------------------------------------\n");
+  std::cout << "Your Code: Timing Summary" << std::endl;
+  std::cout << timing.str();
+  printf("----------------------------------------------------------\n");
+  std::cout << "Serial Reference: Timing Summary" << std::endl;
+  printf("        WCC %.4f    SCC %.4f\n", ref_cc_time, ref_scc_time);
+  printf("----------------------------------------------------------\n");
+  std::cout << "Correctness: " << std::endl;
+  if (!cc_check) std::cout << "WCC is not Correct" << std::endl;
+  if (!scc_check) std::cout << "SCC is not Correct" << std::endl;
+  std::cout << std::endl
+            << "Speedup vs. Serial Reference: " << std::endl
+            << relative_timing.str();
+
+  free(ref_cc);
+  free(ref_scc);
+  free(sol_cc);
+  free(sol_scc);
+  free_graph(g);
+
+  return 0;
+}
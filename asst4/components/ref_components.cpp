@@ -0,0 +1,117 @@
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <algorithm>
+#include <utility>
+#include <vector>
+
+#include "components.h"
+
+// Serial reference implementations.  These are deliberately simple and
+// are only used to check the parallel kernels.
+
+static int find(int *parent, int v) {
+  while (parent[v] != v) {
+    parent[v] = parent[parent[v]];
+    v = parent[v];
+  }
+  return v;
+}
+
+void reference_cc(Graph g, int *labels) {
+  for (int v = 0; v < g->num_nodes; v++) labels[v] = v;
+
+  for (int u = 0; u < g->num_nodes; u++) {
+    const Vertex *begin = outgoing_begin(g, u);
+    const Vertex *end = outgoing_end(g, u);
+    for (const Vertex *v = begin; v != end; v++) {
+      int ru = find(labels, u);
+      int rv = find(labels, *v);
+      if (ru < rv) labels[rv] = ru;
+      else if (rv < ru) labels[ru] = rv;
+    }
+  }
+
+  for (int v = 0; v < g->num_nodes; v++) labels[v] = find(labels, v);
+}
+
+// Tarjan's algorithm with an explicit call stack so that deep graphs do
+// not overflow the native one.
+void reference_scc(Graph g, int *labels) {
+  int numNodes = num_nodes(g);
+  std::vector<int> index(numNodes, -1);
+  std::vector<int> lowlink(numNodes, 0);
+  std::vector<bool> on_stack(numNodes, false);
+  std::vector<int> stack;
+  // (vertex, position of the next outgoing edge to look at)
+  std::vector<std::pair<int, const Vertex *>> calls;
+  int next_index = 0;
+
+  for (int root = 0; root < numNodes; root++) {
+    if (index[root] != -1) continue;
+
+    calls.push_back({root, outgoing_begin(g, root)});
+    index[root] = lowlink[root] = next_index++;
+    stack.push_back(root);
+    on_stack[root] = true;
+
+    while (!calls.empty()) {
+      int u = calls.back().first;
+      const Vertex *&edge = calls.back().second;
+
+      if (edge != outgoing_end(g, u)) {
+        int w = *edge++;
+        if (index[w] == -1) {
+          index[w] = lowlink[w] = next_index++;
+          stack.push_back(w);
+          on_stack[w] = true;
+          calls.push_back({w, outgoing_begin(g, w)});
+        } else if (on_stack[w]) {
+          lowlink[u] = std::min(lowlink[u], index[w]);
+        }
+        continue;
+      }
+
+      calls.pop_back();
+      if (!calls.empty()) {
+        int parent = calls.back().first;
+        lowlink[parent] = std::min(lowlink[parent], lowlink[u]);
+      }
+
+      if (lowlink[u] == index[u]) {
+        int w;
+        do {
+          w = stack.back();
+          stack.pop_back();
+          on_stack[w] = false;
+          labels[w] = u;
+        } while (w != u);
+      }
+    }
+  }
+}
+
+bool same_components(Graph g, const int *ref, const int *stu) {
+  std::vector<int> ref_to_stu(g->num_nodes, -1);
+  std::vector<int> stu_to_ref(g->num_nodes, -1);
+
+  for (int v = 0; v < g->num_nodes; v++) {
+    if (ref_to_stu[ref[v]] == -1 && stu_to_ref[stu[v]] == -1) {
+      ref_to_stu[ref[v]] = stu[v];
+      stu_to_ref[stu[v]] = ref[v];
+    }
+    if (ref_to_stu[ref[v]] != stu[v] || stu_to_ref[stu[v]] != ref[v]) {
+      fprintf(stderr, "*** Results disagree at %d: %d, %d\n", v, stu[v],
+              ref[v]);
+      return false;
+    }
+  }
+  return true;
+}
+
+int count_components(Graph g, const int *labels) {
+  int count = 0;
+  for (int v = 0; v < g->num_nodes; v++)
+    if (labels[v] == v) count++;
+  return count;
+}
@@ -2,6 +2,7 @@
 #include <omp.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 
 #include <iostream>
 #include <sstream>
@@ -9,6 +10,7 @@
 #include <vector>
 
 #include "common/CycleTimer.h"
+#include "common/benchmark.h"
 #include "common/grade.h"
 #include "common/graph.h"
 #include "page_rank.h"
@@ -21,25 +23,94 @@
 void reference_pageRank(Graph g, double* solution, double damping,
                         double convergence);
 
+// PageRank implementations selectable with -e
+struct pr_engine {
+  const char* name;
+  void (*run)(Graph g, double* solution, double damping, double convergence);
+  // Optional: same as run, also recording per-round work
+  void (*run_stats)(Graph g, double* solution, double damping,
+                    double convergence, std::vector<pr_round_stats>* rounds);
+};
+
+static void pageRankDeltaEngine(Graph g, double* solution, double damping,
+                                double convergence) {
+  pageRankDelta(g, solution, damping, convergence);
+}
+
+static const pr_engine engines[] = {
+    {"pull", pageRank, NULL},
+    {"baseline", pageRankBaseline, NULL},
+    {"blocked", pageRankBlocked, NULL},
+    {"delta", pageRankDeltaEngine, pageRankDelta},
+    {"mixed", pageRankMixed, NULL},
+};
+
+// Runs the engine once more and prints how much of the graph each
+// round touched, relative to a full sweep over all edges.
+void print_round_stats(Graph g, const pr_engine* engine) {
+  std::vector<pr_round_stats> rounds;
+  double* sol = (double*)malloc(sizeof(double) * g->num_nodes);
+  engine->run_stats(g, sol, PageRankDampening, PageRankConvergence, &rounds);
+  free(sol);
+
+  long total_edges = 0;
+  printf("----------------------------------------------------------\n");
+  printf("Round    Frontier         Edges   %% of edges\n");
+  for (size_t i = 0; i < rounds.size(); i++) {
+    printf("%5zu  %10d  %12ld   %9.2f%%\n", i, rounds[i].frontier_size,
+           rounds[i].edges_processed,
+           100.0 * rounds[i].edges_processed / g->num_edges);
+    total_edges += rounds[i].edges_processed;
+  }
+  printf("Total edges processed: %ld (%.2f full sweeps)\n", total_edges,
+         (double)total_edges / g->num_edges);
+}
+
+void usage(const char* binary_name) {
+  std::cerr << "Usage: " << binary_name
+            << " [-e engine] <path/to/graph/file> [num_threads]\n";
+  std::cerr << "  To run results for all thread counts: <path/to/graph/file>\n";
+  std::cerr << "  Run with a certain number of threads (no correctness run): "
+               "<path/to/graph/file> <num_threads>\n";
+  std::cerr << "  -e  engine to run (default: " << engines[0].name
+            << "), one of:";
+  for (const pr_engine& e : engines) std::cerr << " " << e.name;
+  std::cerr << "\n";
+}
+
 int main(int argc, char** argv) {
   int         num_threads = -1;
   std::string graph_filename;
+  const pr_engine* engine = &engines[0];
+
+  int opt;
+  while ((opt = getopt(argc, argv, "e:h")) != EOF) {
+    switch (opt) {
+      case 'e':
+        engine = NULL;
+        for (const pr_engine& e : engines)
+          if (!strcmp(e.name, optarg)) engine = &e;
+        if (engine) break;
+        std::cerr << "Unknown engine: " << optarg << "\n";
+        // fall through
+      case 'h':
+      default:
+        usage(argv[0]);
+        exit(1);
+    }
+  }
 
-  if (argc < 2) {
-    std::cerr << "Usage: <path/to/graph/file> [num_threads]\n";
-    std::cerr
-        << "  To run results for all thread counts: <path/to/graph/file>\n";
-    std::cerr << "  Run with a certain number of threads (no correctness run): "
-                 "<path/to/graph/file> <num_threads>\n";
+  if (optind >= argc) {
+    usage(argv[0]);
     exit(1);
   }
 
   int thread_count = -1;
-  if (argc == 3) {
-    thread_count = atoi(argv[2]);
+  if (optind + 1 < argc) {
+    thread_count = atoi(argv[optind + 1]);
   }
 
-  graph_filename = argv[1];
+  graph_filename = argv[optind];
 
   Graph g;
 
@@ -55,7 +126,7 @@ int main(int argc, char** argv) {
   if (USE_BINARY_GRAPH) {
     g = load_graph_binary(graph_filename.c_str());
   } else {
-    g = load_graph(argv[1]);
+    g = load_graph(graph_filename.c_str());
     printf("storing binary form of graph!\n");
     store_graph_binary(graph_filename.append(".bin").c_str(), g);
     delete g;
@@ -65,19 +136,16 @@ int main(int argc, char** argv) {
   printf("Graph stats:\n");
   printf("  Edges: %d\n", g->num_edges);
   printf("  Nodes: %d\n", g->num_nodes);
+  printf("  Engine: %s\n", engine->name);
+
+  if (engine->run_stats) print_round_stats(g, engine);
 
   // If we want to run on all threads
   if (thread_count <= -1) {
     // Static num_threads to get consistent usage across trials
     int max_threads = omp_get_max_threads();
 
-    std::vector<int> num_threads;
-
-    // dynamic num_threads
-    for (int i = 1; i < max_threads; i *= 2) {
-      num_threads.push_back(i);
-    }
-    num_threads.push_back(max_threads);
+    std::vector<int> num_threads = bench_thread_counts(max_threads);
     int n_usage = num_threads.size();
 
     double* sol1;
@@ -93,6 +161,7 @@ int main(int argc, char** argv) {
 
     double pagerank_base;
     double pagerank_time;
+    double baseline_time;
 
     double ref_pagerank_base;
     double ref_pagerank_time;
@@ -104,7 +173,7 @@ int main(int argc, char** argv) {
 
     bool pr_check = true;
 
-    timing << "Threads  Time (Speedup)\n";
+    timing << "Threads  Time (Speedup)       Baseline   vs. Baseline\n";
     ref_timing << "Threads  Time (Speedup)\n";
     relative_timing << "Threads  Speedup\n";
 
@@ -117,9 +186,13 @@ int main(int argc, char** argv) {
 
       // Run implementations
       start = CycleTimer::currentSeconds();
-      pageRank(g, sol1, PageRankDampening, PageRankConvergence);
+      engine->run(g, sol1, PageRankDampening, PageRankConvergence);
       pagerank_time = CycleTimer::currentSeconds() - start;
 
+      start = CycleTimer::currentSeconds();
+      pageRankBaseline(g, sol2, PageRankDampening, PageRankConvergence);
+      baseline_time = CycleTimer::currentSeconds() - start;
+
       // Run staff reference implementation
       start = CycleTimer::currentSeconds();
       reference_pageRank(g, sol4, PageRankDampening, PageRankConvergence);
@@ -140,8 +213,9 @@ int main(int argc, char** argv) {
       char ref_buf[1024];
       char relative_buf[1024];
 
-      sprintf(buf, "%4d:   %.4f (%.4fx)\n", num_threads[i], pagerank_time,
-              pagerank_base / pagerank_time);
+      sprintf(buf, "%4d:   %.4f (%.4fx)    %.4f     %.2fx\n", num_threads[i],
+              pagerank_time, pagerank_base / pagerank_time, baseline_time,
+              baseline_time / pagerank_time);
       sprintf(ref_buf, "%4d:   %.4f (%.4fx)\n", num_threads[i],
               ref_pagerank_time, ref_pagerank_base / ref_pagerank_time);
       sprintf(relative_buf, "%4d:     %.2fx\n", num_threads[i],
@@ -179,17 +253,16 @@ int main(int argc, char** argv) {
     double* sol4;
     sol4 = (double*)malloc(sizeof(double) * g->num_nodes);
 
-    double pagerank_base;
     double pagerank_time;
+    double baseline_time;
 
-    double ref_pagerank_base;
     double ref_pagerank_time;
 
     double            start;
     std::stringstream timing;
     std::stringstream ref_timing;
 
-    timing << "Threads  Time\n";
+    timing << "Threads  Time      Baseline  vs. Baseline\n";
     ref_timing << "Threads  Time\n";
 
     // Loop through assignment values;
@@ -199,9 +272,13 @@ int main(int argc, char** argv) {
 
     // Run implementations
     start = CycleTimer::currentSeconds();
-    pageRank(g, sol1, PageRankDampening, PageRankConvergence);
+    engine->run(g, sol1, PageRankDampening, PageRankConvergence);
     pagerank_time = CycleTimer::currentSeconds() - start;
 
+    start = CycleTimer::currentSeconds();
+    pageRankBaseline(g, sol2, PageRankDampening, PageRankConvergence);
+    baseline_time = CycleTimer::currentSeconds() - start;
+
     // Run reference implementation
     start = CycleTimer::currentSeconds();
     reference_pageRank(g, sol4, PageRankDampening, PageRankConvergence);
@@ -215,7 +292,8 @@ int main(int argc, char** argv) {
     char buf[1024];
     char ref_buf[1024];
 
-    sprintf(buf, "%4d:   %.4f\n", thread_count, pagerank_time);
+    sprintf(buf, "%4d:   %.4f    %.4f    %.2fx\n", thread_count, pagerank_time,
+            baseline_time, baseline_time / pagerank_time);
     sprintf(ref_buf, "%4d:   %.4f\n", thread_count, ref_pagerank_time);
 
     timing << buf;
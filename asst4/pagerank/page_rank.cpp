@@ -12,6 +12,8 @@
 
 #include "../common/CycleTimer.h"
 #include "../common/graph.h"
+#include "../common/simd_gather.h"
+#include "page_rank_util.h"
 
 // pageRank --
 //
@@ -20,7 +22,76 @@
 // num_nodes(g)) damping:     page-rank algorithm's damping parameter
 // convergence: page-rank algorithm's convergence threshold
 //
+// Pull-based: every vertex publishes contrib[v] = score[v] / outdeg(v),
+// using a reciprocal degree computed up front, so the gather over
+// incoming edges is a plain sum of contrib[] kept in a register.
+//
+// An iteration is a single pass over the vertices.  Writing the new
+// score of v also produces everything the next iteration needs from v:
+// its contribution (into the other of two contrib buffers, since this
+// iteration is still reading the first), its share of the dangling sum
+// and its change for the convergence test.  Only v itself reads
+// solution[v], so the scores are updated in place.
 void pageRank(Graph g, double *solution, double damping, double convergence) {
+  int numNodes = num_nodes(g);
+  double equal_prob = 1.0 / numNodes;
+  for (int i = 0; i < numNodes; ++i) {
+    solution[i] = equal_prob;
+  }
+
+  pageRankIterate(g, solution, damping, convergence);
+}
+
+int pageRankIterate(Graph g, double *solution, double damping,
+                    double convergence) {
+  int numNodes = num_nodes(g);
+  double *contrib = (double *) aligned_alloc(sizeof(double), sizeof(double) * numNodes);
+  double *contrib_next = (double *) aligned_alloc(sizeof(double), sizeof(double) * numNodes);
+  double *inv_outdeg = (double *) aligned_alloc(sizeof(double), sizeof(double) * numNodes);
+
+  compute_inv_outdeg(g, inv_outdeg);
+
+  double dangling = 0.0;
+#pragma omp parallel for reduction(+:dangling) schedule(static)
+  for (int vi = 0; vi < numNodes; ++vi) {
+    contrib[vi] = solution[vi] * inv_outdeg[vi];
+    if (inv_outdeg[vi] == 0.0) dangling += solution[vi];
+  }
+
+  const double base = (1.0 - damping) / numNodes;
+  bool converged = false;
+  int iterations = 0;
+  while (!converged) {
+    const double delta_v = dangling * damping / numNodes;
+    double global_diff = 0.0;
+    double dangling_next = 0.0;
+
+#pragma omp parallel for reduction(+:global_diff, dangling_next) schedule(dynamic, CHUNK)
+    for (int vi = 0; vi < numNodes; ++vi) {
+      const Vertex *start = incoming_begin(g, vi);
+      const Vertex *end = incoming_end(g, vi);
+      double sum = gather_sum(contrib, start, end - start);
+      double score = damping * sum + base + delta_v;
+
+      global_diff += std::abs(score - solution[vi]);
+      if (inv_outdeg[vi] == 0.0) dangling_next += score;
+      contrib_next[vi] = score * inv_outdeg[vi];
+      solution[vi] = score;
+    }
+
+    std::swap(contrib, contrib_next);
+    dangling = dangling_next;
+    converged = (global_diff < convergence);
+    iterations++;
+  }
+
+  free(contrib);
+  free(contrib_next);
+  free(inv_outdeg);
+  return iterations;
+}
+
+void pageRankBaseline(Graph g, double *solution, double damping, double convergence) {
   // initialize vertex weights to uniform probability. Double
   // precision scores are used to avoid underflow for large graphs
 
@@ -61,26 +132,8 @@ void pageRank(Graph g, double *solution, double damping, double convergence) {
 
   double *score_new = (double *) aligned_alloc(sizeof(double), sizeof(double) * numNodes);
   int *node_v = (int *) aligned_alloc(sizeof(int), sizeof(int) * numNodes);
-  int *node_bk = (int *) aligned_alloc(sizeof(int), sizeof(int) * numNodes);
   bool converged = false;
-  int numEmptyNodes = 0;
-#define CHUNK 100
-
-#pragma omp parallel for schedule(dynamic, CHUNK)
-  for (int vi = 0; vi < numNodes; ++vi) {
-    // collect nodes with no outgoing edges (in parallel)
-    node_v[vi] = outgoing_size(g, vi) == 0 ? 1 : 0;
-  }
-
-  std::exclusive_scan(std::execution::par_unseq, node_v, node_v + numNodes, node_bk, 0);
-  numEmptyNodes = node_v[numNodes - 1] + node_bk[numNodes - 1];
-
-  // Collect index inplace
-#pragma omp parallel for schedule(dynamic, CHUNK)
-  for (int vi = 0; vi < numNodes; ++vi)
-    if (node_v[vi] == 1)
-      node_v[node_bk[vi]] = vi;
-  free(node_bk);
+  int numEmptyNodes = collect_dangling(g, node_v);
 
   while (!converged) {
     double delta_v = 0;
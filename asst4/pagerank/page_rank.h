@@ -1,8 +1,79 @@
 #ifndef __PAGE_RANK_H__
 #define __PAGE_RANK_H__
 
+#include <vector>
+
 #include "common/graph.h"
+#include "common/graph_shards.h"
 
 void pageRank(Graph g, double* solution, double damping, double convergence);
 
+// Runs pageRank's iterations starting from the scores already in
+// solution instead of the uniform vector.  Always does at least one;
+// returns how many it did.
+int pageRankIterate(Graph g, double* solution, double damping,
+                     double convergence);
+
+// The original gather kernel (division by outgoing_size per edge), kept
+// as a baseline for the other engines.
+void pageRankBaseline(Graph g, double* solution, double damping,
+                      double convergence);
+
+// Push-based PageRank with propagation blocking: contributions are
+// first scattered into cache-sized destination bins, then each bin is
+// accumulated on its own.  Meant for graphs whose score array does not
+// fit in the last level cache.
+void pageRankBlocked(Graph g, double* solution, double damping,
+                     double convergence);
+
+// PageRank that gathers float contributions for most of the edge
+// sweeps, accumulating in double, and finishes with double iterations.
+void pageRankMixed(Graph g, double* solution, double damping,
+                   double convergence);
+
+// Personalized PageRank: teleport[v] is the probability of jumping to
+// v (it should sum to 1), used for both the random jumps and the mass
+// of dangling vertices.
+void personalizedPageRank(Graph g, const double* teleport, double* solution,
+                          double damping, double convergence);
+
+// k personalized PageRank queries in one go.  Both arrays hold
+// num_nodes(g) * k doubles, interleaved per vertex: query j of vertex v
+// is at [v * k + j].  Queries are processed in blocks of 32, 8 and 1
+// that each share a single sweep over the edges per iteration.
+void personalizedPageRankBatch(Graph g, int k, const double* teleport,
+                               double* solution, double damping,
+                               double convergence);
+
+// Work done by one round of pageRankDelta
+struct pr_round_stats {
+  int frontier_size;
+  long edges_processed;
+};
+
+// Residual PageRank that only propagates the change of vertices whose
+// pending residual is above a threshold that scales with its
+// out-degree.  Returns pageRank's scores (to within 1e-11) with at most
+// as much edge work.  If rounds is not NULL,
+// it receives one entry per round.
+void pageRankDelta(Graph g, double* solution, double damping,
+                   double convergence,
+                   std::vector<pr_round_stats>* rounds = NULL);
+
+// I/O done by one run of pageRankShards
+struct pr_shard_stats {
+  int iterations;
+  long bytes_read;
+  // Time spent waiting for a shard that was not read in yet
+  double io_wait;
+};
+
+// pageRank over a graph partitioned with `graphTools partition`, for
+// graphs whose edges do not fit in memory: only the per-vertex arrays
+// stay resident, and every iteration streams the shards from disk
+// while the next one is read in the background.  Computes the same
+// scores as pageRank.  If stats is not NULL, it receives the I/O done.
+void pageRankShards(GraphShards shards, double* solution, double damping,
+                    double convergence, pr_shard_stats* stats = NULL);
+
 #endif /* __PAGE_RANK_H__ */
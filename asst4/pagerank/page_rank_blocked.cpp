@@ -0,0 +1,151 @@
+#include <omp.h>
+#include <stdlib.h>
+
+#include <algorithm>
+#include <cmath>
+
+#include "../common/graph.h"
+#include "page_rank.h"
+#include "page_rank_util.h"
+
+// Destinations per bin.  The per-bin slice of score_new (2^BIN_BITS
+// doubles, 512KB) is what the accumulation pass touches at random, so
+// it should fit comfortably in the L2/LLC slice of one core.
+#define BIN_BITS 16
+#define BIN_SIZE (1 << BIN_BITS)
+
+// Source blocks per thread; blocks hold roughly equal numbers of edges.
+#define BLOCKS_PER_THREAD 4
+
+// pageRankBlocked --
+//
+// Push-based PageRank with propagation blocking.  Each iteration runs
+// two passes:
+//
+//  1. binning: every source block streams its vertices in order and
+//     appends contrib[u] for each outgoing edge u->v to the bin of v;
+//  2. accumulation: every bin is summed into its slice of score_new.
+//
+// The graph is static, so the destination of every bin slot is
+// computed once up front and the binning pass only writes values.  All
+// random accesses of pass 2 stay inside one bin's slice of score_new,
+// and pass 1 only writes sequential streams (one per bin).
+void pageRankBlocked(Graph g, double *solution, double damping,
+                     double convergence) {
+  int numNodes = num_nodes(g);
+  int numEdges = num_edges(g);
+  int num_bins = (numNodes + BIN_SIZE - 1) / BIN_SIZE;
+  int num_blocks = omp_get_max_threads() * BLOCKS_PER_THREAD;
+
+  double equal_prob = 1.0 / numNodes;
+  for (int i = 0; i < numNodes; ++i) {
+    solution[i] = equal_prob;
+  }
+
+  // Source block boundaries, balanced by edge count.
+  int *block_start = (int *) malloc(sizeof(int) * (num_blocks + 1));
+  for (int b = 0; b < num_blocks; b++) {
+    long target = (long) numEdges * b / num_blocks;
+    block_start[b] = std::lower_bound(g->outgoing_starts,
+                                      g->outgoing_starts + numNodes, target) -
+                     g->outgoing_starts;
+  }
+  block_start[num_blocks] = numNodes;
+
+  // cursor[block * num_bins + bin] is where the block's next value for
+  // that bin goes.  Bins are laid out one after another, and within a
+  // bin the blocks' segments follow in block order.
+  int *counts = (int *) calloc((size_t) num_blocks * num_bins, sizeof(int));
+  int *cursor = (int *) malloc(sizeof(int) * (size_t) num_blocks * num_bins);
+  int *bin_start = (int *) malloc(sizeof(int) * (num_bins + 1));
+
+#pragma omp parallel for schedule(dynamic, 1)
+  for (int b = 0; b < num_blocks; b++) {
+    int *block_counts = counts + (size_t) b * num_bins;
+    for (int u = block_start[b]; u < block_start[b + 1]; u++)
+      for (const Vertex *v = outgoing_begin(g, u); v != outgoing_end(g, u); v++)
+        block_counts[*v >> BIN_BITS]++;
+  }
+
+  int offset = 0;
+  for (int bin = 0; bin < num_bins; bin++) {
+    bin_start[bin] = offset;
+    for (int b = 0; b < num_blocks; b++) {
+      cursor[(size_t) b * num_bins + bin] = offset;
+      offset += counts[(size_t) b * num_bins + bin];
+    }
+  }
+  bin_start[num_bins] = offset;
+
+  Vertex *dests = (Vertex *) malloc(sizeof(Vertex) * numEdges);
+  double *values = (double *) malloc(sizeof(double) * numEdges);
+
+#pragma omp parallel for schedule(dynamic, 1)
+  for (int b = 0; b < num_blocks; b++) {
+    int *pos = counts + (size_t) b * num_bins;
+    std::copy(cursor + (size_t) b * num_bins,
+              cursor + (size_t) (b + 1) * num_bins, pos);
+    for (int u = block_start[b]; u < block_start[b + 1]; u++)
+      for (const Vertex *v = outgoing_begin(g, u); v != outgoing_end(g, u); v++)
+        dests[pos[*v >> BIN_BITS]++] = *v;
+  }
+
+  double *score_new = (double *) aligned_alloc(sizeof(double), sizeof(double) * numNodes);
+  double *inv_outdeg = (double *) aligned_alloc(sizeof(double), sizeof(double) * numNodes);
+  int *node_v = (int *) aligned_alloc(sizeof(int), sizeof(int) * numNodes);
+  compute_inv_outdeg(g, inv_outdeg);
+  int numEmptyNodes = collect_dangling(g, node_v);
+
+  const double base = (1.0 - damping) / numNodes;
+  bool converged = false;
+  while (!converged) {
+    double delta_v = 0;
+#pragma omp parallel for reduction(+:delta_v) schedule(dynamic, CHUNK)
+    for (int v_index = 0; v_index < numEmptyNodes; ++v_index)
+      delta_v += solution[node_v[v_index]];
+    delta_v = delta_v * damping / numNodes;
+
+    // Pass 1: binning
+#pragma omp parallel for schedule(dynamic, 1)
+    for (int b = 0; b < num_blocks; b++) {
+      int *pos = counts + (size_t) b * num_bins;
+      std::copy(cursor + (size_t) b * num_bins,
+                cursor + (size_t) (b + 1) * num_bins, pos);
+      for (int u = block_start[b]; u < block_start[b + 1]; u++) {
+        double contrib = solution[u] * inv_outdeg[u];
+        for (const Vertex *v = outgoing_begin(g, u); v != outgoing_end(g, u); v++)
+          values[pos[*v >> BIN_BITS]++] = contrib;
+      }
+    }
+
+    // Pass 2: accumulation, one bin at a time
+    double global_diff = 0.0;
+#pragma omp parallel for reduction(+:global_diff) schedule(dynamic, 1)
+    for (int bin = 0; bin < num_bins; bin++) {
+      int first = bin << BIN_BITS;
+      int last = std::min(numNodes, first + BIN_SIZE);
+
+      for (int vi = first; vi < last; vi++) score_new[vi] = 0.0;
+      for (int k = bin_start[bin]; k < bin_start[bin + 1]; k++)
+        score_new[dests[k]] += values[k];
+
+      for (int vi = first; vi < last; vi++) {
+        double score = damping * score_new[vi] + base + delta_v;
+        global_diff += std::abs(score - solution[vi]);
+        solution[vi] = score;
+      }
+    }
+
+    converged = (global_diff < convergence);
+  }
+
+  free(block_start);
+  free(counts);
+  free(cursor);
+  free(bin_start);
+  free(dests);
+  free(values);
+  free(score_new);
+  free(inv_outdeg);
+  free(node_v);
+}
@@ -0,0 +1,115 @@
+#include <omp.h>
+#include <stdlib.h>
+
+#include <cmath>
+#include <utility>
+
+#include "../common/graph.h"
+#include "page_rank.h"
+#include "page_rank_util.h"
+
+// ppr_block --
+//
+// Runs K personalized PageRank queries together.  Query j's teleport
+// distribution and scores are teleport[v * stride + j] and
+// solution[v * stride + j].  The contributions are kept interleaved,
+// K per vertex, so the gather over incoming edges reads K consecutive
+// doubles per edge and the inner loop over the queries vectorizes.
+//
+// Each iteration is fused like pageRank's.  Dangling vertices jump back
+// according to the teleport distribution, so with a uniform teleport
+// vector this computes the same scores as pageRank.
+template <int K>
+static void ppr_block(Graph g, const double *teleport, double *solution,
+                      int stride, const double *inv_outdeg, double damping,
+                      double convergence) {
+  int numNodes = num_nodes(g);
+  double *contrib = (double *) aligned_alloc(sizeof(double), sizeof(double) * numNodes * K);
+  double *contrib_next = (double *) aligned_alloc(sizeof(double), sizeof(double) * numNodes * K);
+
+  double dangling[K] = {};
+#pragma omp parallel for reduction(+:dangling[:K]) schedule(static)
+  for (int vi = 0; vi < numNodes; ++vi) {
+    for (int j = 0; j < K; j++) {
+      double score = teleport[(long) vi * stride + j];
+      solution[(long) vi * stride + j] = score;
+      contrib[(long) vi * K + j] = score * inv_outdeg[vi];
+      if (inv_outdeg[vi] == 0.0) dangling[j] += score;
+    }
+  }
+
+  // Queries that have converged keep their scores (and contributions)
+  // from then on, so each one stops after the same iteration as it
+  // would on its own.
+  bool active[K];
+  for (int j = 0; j < K; j++) active[j] = true;
+
+  bool converged = false;
+  while (!converged) {
+    double jump[K];
+    for (int j = 0; j < K; j++) jump[j] = 1.0 - damping + damping * dangling[j];
+
+    double global_diff[K] = {};
+    double dangling_next[K] = {};
+
+#pragma omp parallel for reduction(+:global_diff[:K], dangling_next[:K]) schedule(dynamic, CHUNK)
+    for (int vi = 0; vi < numNodes; ++vi) {
+      double sum[K] = {};
+      for (const Vertex *v = incoming_begin(g, vi); v != incoming_end(g, vi); v++) {
+        const double *c = contrib + (long) *v * K;
+        for (int j = 0; j < K; j++) sum[j] += c[j];
+      }
+
+      const double *t = teleport + (long) vi * stride;
+      double *s = solution + (long) vi * stride;
+      double *c = contrib_next + (long) vi * K;
+      const double *c_old = contrib + (long) vi * K;
+      for (int j = 0; j < K; j++) {
+        double score = active[j] ? damping * sum[j] + jump[j] * t[j] : s[j];
+        global_diff[j] += std::abs(score - s[j]);
+        if (inv_outdeg[vi] == 0.0) dangling_next[j] += score;
+        c[j] = active[j] ? score * inv_outdeg[vi] : c_old[j];
+        s[j] = score;
+      }
+    }
+
+    std::swap(contrib, contrib_next);
+    converged = true;
+    for (int j = 0; j < K; j++) {
+      dangling[j] = dangling_next[j];
+      if (global_diff[j] < convergence) active[j] = false;
+      converged = converged && !active[j];
+    }
+  }
+
+  free(contrib);
+  free(contrib_next);
+}
+
+void personalizedPageRank(Graph g, const double *teleport, double *solution,
+                          double damping, double convergence) {
+  personalizedPageRankBatch(g, 1, teleport, solution, damping, convergence);
+}
+
+void personalizedPageRankBatch(Graph g, int k, const double *teleport,
+                               double *solution, double damping,
+                               double convergence) {
+  double *inv_outdeg = (double *) aligned_alloc(sizeof(double), sizeof(double) * num_nodes(g));
+  compute_inv_outdeg(g, inv_outdeg);
+
+  // Widest blocks first; a block shares one sweep over the edges
+  for (int j = 0; j < k;) {
+    if (k - j >= 32) {
+      ppr_block<32>(g, teleport + j, solution + j, k, inv_outdeg, damping, convergence);
+      j += 32;
+    } else if (k - j >= 8) {
+      ppr_block<8>(g, teleport + j, solution + j, k, inv_outdeg, damping, convergence);
+      j += 8;
+    } else {
+      ppr_block<1>(g, teleport + j, solution + j, k, inv_outdeg, damping, convergence);
+      j += 1;
+    }
+  }
+
+  free(inv_outdeg);
+}
@@ -0,0 +1,116 @@
+#include <omp.h>
+#include <stdlib.h>
+
+#include <cmath>
+#include <thread>
+#include <utility>
+
+#include "../common/CycleTimer.h"
+#include "../common/graph_shards.h"
+#include "../common/simd_gather.h"
+#include "page_rank.h"
+#include "page_rank_util.h"
+
+// pageRankShards --
+//
+// The iterations of pageRankIterate, with the incoming edges coming
+// from the shards instead of the graph.  Shard s only holds the edges
+// into vertices shard_starts[s] .. shard_starts[s + 1] - 1, so a sweep
+// over the shards in order visits the vertices in the same order, and
+// gathers from the same sources in the same order, as pageRank does.
+//
+// Two shard buffers are used: while the vertices of one shard are
+// updated, a helper thread reads the shard after it (wrapping around
+// to shard 0 for the next iteration) into the other.  The edges never
+// change, so reading ahead across iterations is safe.  A graph with a
+// single shard is read once and kept.
+void pageRankShards(GraphShards shards, double *solution, double damping,
+                    double convergence, pr_shard_stats *stats) {
+  int numNodes = shards->num_nodes;
+  int numShards = shards->num_shards;
+  double *contrib = (double *) aligned_alloc(sizeof(double), sizeof(double) * numNodes);
+  double *contrib_next = (double *) aligned_alloc(sizeof(double), sizeof(double) * numNodes);
+  double *inv_outdeg = (double *) aligned_alloc(sizeof(double), sizeof(double) * numNodes);
+
+  const double equal_prob = 1.0 / numNodes;
+  double dangling = 0.0;
+#pragma omp parallel for reduction(+:dangling) schedule(static)
+  for (int vi = 0; vi < numNodes; ++vi) {
+    int outdeg = shards->outgoing_sizes[vi];
+    inv_outdeg[vi] = outdeg == 0 ? 0.0 : 1.0 / outdeg;
+    solution[vi] = equal_prob;
+    contrib[vi] = solution[vi] * inv_outdeg[vi];
+    if (inv_outdeg[vi] == 0.0) dangling += solution[vi];
+  }
+
+  graph_shard buffers[2];
+  shard_init(shards, &buffers[0]);
+  shard_init(shards, &buffers[1]);
+
+  pr_shard_stats io = {0, 0, 0.0};
+  read_shard(shards, 0, &buffers[0]);
+  io.bytes_read += shard_bytes(shards, 0);
+
+  std::thread prefetch;
+  int current = 0;
+
+  const double base = (1.0 - damping) / numNodes;
+  bool converged = false;
+  while (!converged) {
+    const double delta_v = dangling * damping / numNodes;
+    double global_diff = 0.0;
+    double dangling_next = 0.0;
+
+    // One parallel region for the whole sweep, so that every thread's
+    // share of the sums is added up once, as in pageRankIterate
+#pragma omp parallel reduction(+:global_diff, dangling_next)
+    for (int s = 0; s < numShards; s++) {
+#pragma omp single
+      {
+        if (prefetch.joinable()) {
+          double start = CycleTimer::currentSeconds();
+          prefetch.join();
+          io.io_wait += CycleTimer::currentSeconds() - start;
+          current = 1 - current;
+        }
+        if (numShards > 1) {
+          int next = (s + 1) % numShards;
+          graph_shard *buffer = &buffers[1 - current];
+          prefetch = std::thread([=] { read_shard(shards, next, buffer); });
+          io.bytes_read += shard_bytes(shards, next);
+        }
+      }
+
+      const graph_shard *shard = &buffers[current];
+      const int first = shard->first_node;
+      const int last = first + shard->num_nodes;
+#pragma omp for schedule(dynamic, CHUNK)
+      for (int vi = first; vi < last; ++vi) {
+        const Vertex *start = shard_incoming_begin(shard, vi);
+        const Vertex *end = shard_incoming_end(shard, vi);
+        double sum = gather_sum(contrib, start, end - start);
+        double score = damping * sum + base + delta_v;
+
+        global_diff += std::abs(score - solution[vi]);
+        if (inv_outdeg[vi] == 0.0) dangling_next += score;
+        contrib_next[vi] = score * inv_outdeg[vi];
+        solution[vi] = score;
+      }
+    }
+
+    std::swap(contrib, contrib_next);
+    dangling = dangling_next;
+    converged = (global_diff < convergence);
+    io.iterations++;
+  }
+
+  // The read of the first shard for an iteration that will not happen
+  if (prefetch.joinable()) prefetch.join();
+  if (stats) *stats = io;
+
+  shard_free(&buffers[0]);
+  shard_free(&buffers[1]);
+  free(contrib);
+  free(contrib_next);
+  free(inv_outdeg);
+}
@@ -0,0 +1,339 @@
+#include "page_rank_stream.h"
+
+#include <omp.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <algorithm>
+#include <utility>
+#include <vector>
+
+#include "../common/graph.h"
+#include "../common/simd_gather.h"
+#include "page_rank_util.h"
+
+// Edges a batch may push, as a fraction of all edges, before the
+// residual still pending is left to pull sweeps instead.  A push is an
+// atomic add at a random vertex, about ten times the cost of a gathered
+// load on r16, so a tenth of the edges pushed costs about one sweep.
+// Past that, the batch has reached most of the graph anyway.
+#define PUSH_BUDGET 0.1
+
+// Overlay edges, as a fraction of all edges, past which the fallback
+// folds the overlay into a new base graph before sweeping
+#define OVERLAY_BUDGET 0.25
+
+// How much each settle level lowers the per-edge threshold
+#define SETTLE_STEP 4
+
+static inline std::pair<const Vertex *, const Vertex *>
+stream_out_edges(const pagerank_stream *s, Vertex v) {
+  if (s->has_overlay[v]) {
+    const std::vector<Vertex> &adj = s->overlay[v];
+    return std::make_pair(adj.data(), adj.data() + adj.size());
+  }
+  return std::make_pair(outgoing_begin(s->g, v), outgoing_end(s->g, v));
+}
+
+// Returns v's own edge list, copying it out of the CSR on first use
+static std::vector<Vertex> &stream_edges_for_update(pagerank_stream *s, Vertex v) {
+  if (!s->has_overlay[v]) {
+    s->overlay[v].assign(outgoing_begin(s->g, v), outgoing_end(s->g, v));
+    s->has_overlay[v] = true;
+    s->overlay_edges += s->overlay[v].size();
+  }
+  return s->overlay[v];
+}
+
+// Runs pageRankIterate on the base graph from scores and puts the
+// result into residual form, without the dangling term: scaled by
+// (1 - damping) / (1 - damping + damping * dangling mass), which is
+// where the residual iteration converges, and with the residual of one
+// more iteration.  Uses scores as scratch.
+static void stream_solve(pagerank_stream *s, double *scores) {
+  const Graph g = s->g;
+  int numNodes = num_nodes(g);
+  pageRankIterate(g, scores, s->damping, s->convergence);
+
+  double dangling = 0.0;
+#pragma omp parallel for reduction(+:dangling) schedule(static)
+  for (int vi = 0; vi < numNodes; ++vi)
+    if (s->inv_outdeg[vi] == 0.0) dangling += scores[vi];
+  const double scale = (1.0 - s->damping) / (1.0 - s->damping + s->damping * dangling);
+
+  // scores becomes the contributions
+#pragma omp parallel for schedule(static)
+  for (int vi = 0; vi < numNodes; ++vi) {
+    s->solution[vi] = scale * scores[vi];
+    scores[vi] = s->solution[vi] * s->inv_outdeg[vi];
+  }
+  const double base = (1.0 - s->damping) / numNodes;
+#pragma omp parallel for schedule(dynamic, CHUNK)
+  for (int vi = 0; vi < numNodes; ++vi) {
+    const Vertex *start = incoming_begin(g, vi);
+    double sum = gather_sum(scores, start, incoming_end(g, vi) - start);
+    s->residual[vi] = base + s->damping * sum - s->solution[vi];
+  }
+}
+
+// Makes a snapshot of the current edges the new base graph, so that
+// sweeps gather over all of them instead of scattering from a large
+// overlay.  The edges do not change, so neither do the residuals.
+static void stream_rebase(pagerank_stream *s) {
+  int numNodes = num_nodes(s->g);
+  Graph snap = pagerank_stream_snapshot(s);
+  if (s->owns_graph) free_graph(s->g);
+  s->g = snap;
+  s->owns_graph = true;
+#pragma omp parallel for schedule(dynamic, CHUNK)
+  for (int vi = 0; vi < numNodes; ++vi) {
+    if (s->has_overlay[vi]) {
+      std::vector<Vertex>().swap(s->overlay[vi]);
+      s->has_overlay[vi] = false;
+    }
+  }
+  s->overlay_edges = 0;
+}
+
+// Pull sweeps until the residuals add up to at most the budget.  A
+// sweep adds the residuals into the solution and recomputes them in
+// full: scattered from the overlay vertices, then gathered over g's
+// incoming edges from every vertex still using its CSR edges.  Each
+// sweep shrinks the residuals by about damping, for a gathered load per
+// edge.
+static void stream_sweep(pagerank_stream *s, std::vector<pr_round_stats> *rounds) {
+  int numNodes = num_nodes(s->g);
+  double *contrib = (double *) aligned_alloc(sizeof(double), sizeof(double) * numNodes);
+  const double base = (1.0 - s->damping) / numNodes;
+
+  double total = 0.0;
+#pragma omp parallel for reduction(+:total) schedule(static)
+  for (int vi = 0; vi < numNodes; ++vi) total += std::abs(s->residual[vi]);
+
+  while (total > s->budget) {
+#pragma omp parallel for schedule(static)
+    for (int vi = 0; vi < numNodes; ++vi) {
+      s->solution[vi] += s->residual[vi];
+      s->residual[vi] = 0.0;
+      contrib[vi] = s->has_overlay[vi] ? 0.0 : s->solution[vi] * s->inv_outdeg[vi];
+    }
+    for (int vi = 0; vi < numNodes; ++vi) {
+      if (!s->has_overlay[vi]) continue;
+      double delta = s->damping * s->solution[vi] * s->inv_outdeg[vi];
+      for (Vertex w : s->overlay[vi]) s->residual[w] += delta;
+    }
+
+    total = 0.0;
+#pragma omp parallel for reduction(+:total) schedule(dynamic, CHUNK)
+    for (int vi = 0; vi < numNodes; ++vi) {
+      const Vertex *start = incoming_begin(s->g, vi);
+      double sum = gather_sum(contrib, start, incoming_end(s->g, vi) - start);
+      s->residual[vi] += base + s->damping * sum - s->solution[vi];
+      total += std::abs(s->residual[vi]);
+    }
+    if (rounds) rounds->push_back({numNodes, s->num_edges});
+  }
+
+  free(contrib);
+}
+
+// Pushes until the residuals add up to at most the budget.  Each level
+// pushes from every vertex whose residual per outgoing edge is over a
+// threshold, starting at the mean residual per edge and lowered by
+// SETTLE_STEP while the total is still over budget.  The threshold
+// follows the residual actually left, not the graph size, so a small
+// batch stops as soon as the vertices it touched are settled instead of
+// spreading to every vertex it reaches at all.  Returns false if
+// edge_budget ran out first, with the residuals still valid.
+static bool stream_settle(pagerank_stream *s, std::vector<pr_round_stats> *rounds,
+                          long *edge_budget) {
+  int numNodes = num_nodes(s->g);
+  double threshold = INFINITY;
+  while (true) {
+    double total = 0.0;
+#pragma omp parallel for reduction(+:total) schedule(static)
+    for (int vi = 0; vi < numNodes; ++vi) total += std::abs(s->residual[vi]);
+    if (total <= s->budget) return true;
+    threshold = std::min(threshold / SETTLE_STEP, total / std::max(s->num_edges, 1l));
+
+    // on_frontier is all clear between levels
+    vertex_list frontier = {0, s->frontier};
+    vertex_list next = {0, s->next};
+    for (int vi = 0; vi < numNodes; ++vi) {
+      if (over_threshold(s->residual[vi], s->inv_outdeg[vi], threshold)) {
+        s->on_frontier[vi >> 6] |= 1ull << (vi & 63);
+        frontier.vertices[frontier.count++] = vi;
+      }
+    }
+    if (!push_residuals(s->damping, threshold, s->solution, s->residual,
+                        s->inv_outdeg, s->on_frontier, &frontier, &next,
+                        [s](int v) { return stream_out_edges(s, v); }, rounds,
+                        edge_budget))
+      return false;
+  }
+}
+
+pagerank_stream *pagerank_stream_create(Graph g, double damping,
+                                        double convergence) {
+  int numNodes = num_nodes(g);
+  int bitmap_words = (numNodes + 63) / 64;
+
+  pagerank_stream *s = new pagerank_stream;
+  s->g = g;
+  s->owns_graph = false;
+  s->damping = damping;
+  s->convergence = convergence;
+  // The residuals left after a batch add up to at most
+  // (1 - damping) * convergence, which moves the normalized scores by at
+  // most damping / (1 - damping) * convergence in L1: the same bound
+  // pageRank's stopping test gives.
+  s->budget = (1.0 - damping) * convergence;
+  s->num_edges = num_edges(g);
+  s->overlay_edges = 0;
+  s->solution = (double *) aligned_alloc(sizeof(double), sizeof(double) * numNodes);
+  s->residual = (double *) aligned_alloc(sizeof(double), sizeof(double) * numNodes);
+  s->inv_outdeg = (double *) aligned_alloc(sizeof(double), sizeof(double) * numNodes);
+  s->overlay.resize(numNodes);
+  s->has_overlay = (bool *) calloc(numNodes, sizeof(bool));
+  s->on_frontier = (uint64_t *) malloc(sizeof(uint64_t) * bitmap_words);
+  s->frontier = (int *) malloc(sizeof(int) * numNodes);
+  s->next = (int *) malloc(sizeof(int) * numNodes);
+
+  compute_inv_outdeg(g, s->inv_outdeg);
+
+  memset(s->on_frontier, 0, sizeof(uint64_t) * bitmap_words);
+
+  double *scores = (double *) aligned_alloc(sizeof(double), sizeof(double) * numNodes);
+#pragma omp parallel for schedule(static)
+  for (int vi = 0; vi < numNodes; ++vi) scores[vi] = 1.0 / numNodes;
+  stream_solve(s, scores);
+  free(scores);
+  stream_sweep(s, NULL);
+
+  return s;
+}
+
+// An update of u's edges changes what u contributes to every one of its
+// out-neighbors, damping * solution[u] / outdeg(u).  The residuals are
+// defined against the current contributions, so the old ones are taken
+// back and the new ones added, and stream_settle pushes from there.
+void pagerank_stream_apply(pagerank_stream *s, const edge_update *updates,
+                           int count, std::vector<pr_round_stats> *rounds) {
+  int applied = 0;
+  long edges_processed = 0;
+
+  for (int i = 0; i < count; i++) {
+    Vertex u = updates[i].from;
+    Vertex v = updates[i].to;
+    REQUIRES(0 <= u && u < num_nodes(s->g));
+    REQUIRES(0 <= v && v < num_nodes(s->g));
+
+    std::vector<Vertex> &adj = stream_edges_for_update(s, u);
+    auto pos = std::find(adj.begin(), adj.end(), v);
+    if (updates[i].insert == (pos != adj.end())) continue;
+
+    double contrib = s->damping * s->solution[u] * s->inv_outdeg[u];
+    for (Vertex w : adj) s->residual[w] -= contrib;
+
+    if (updates[i].insert) {
+      adj.push_back(v);
+      s->num_edges++;
+      s->overlay_edges++;
+    } else {
+      *pos = adj.back();
+      adj.pop_back();
+      s->num_edges--;
+      s->overlay_edges--;
+    }
+    s->inv_outdeg[u] = adj.empty() ? 0.0 : 1.0 / adj.size();
+
+    contrib = s->damping * s->solution[u] * s->inv_outdeg[u];
+    for (Vertex w : adj) s->residual[w] += contrib;
+
+    applied++;
+    edges_processed += 2 * adj.size();
+  }
+
+  if (rounds) {
+    rounds->clear();
+    rounds->push_back({applied, edges_processed});
+  }
+
+  long edge_budget = (long) (PUSH_BUDGET * s->num_edges);
+  if (stream_settle(s, rounds, &edge_budget)) return;
+  if (s->overlay_edges > OVERLAY_BUDGET * s->num_edges) stream_rebase(s);
+  stream_sweep(s, rounds);
+}
+
+void pagerank_stream_solution(const pagerank_stream *s, double *solution) {
+  fold_residuals(num_nodes(s->g), s->solution, s->residual, solution);
+}
+
+Graph pagerank_stream_snapshot(const pagerank_stream *s) {
+  int numNodes = num_nodes(s->g);
+
+  graph *snap = (struct graph *) malloc(sizeof(struct graph));
+  snap->num_nodes = numNodes;
+  snap->num_edges = (int) s->num_edges;
+  snap->outgoing_starts = (int *) malloc(sizeof(int) * numNodes);
+  snap->outgoing_edges = (Vertex *) malloc(sizeof(Vertex) * s->num_edges);
+  snap->outgoing_weights = NULL;
+
+  std::vector<Vertex> updated;
+  int offset = 0;
+  for (int v = 0; v < numNodes; v++) {
+    auto [start, end] = stream_out_edges(s, v);
+    snap->outgoing_starts[v] = offset;
+    memcpy(snap->outgoing_edges + offset, start, (end - start) * sizeof(Vertex));
+    offset += end - start;
+    if (s->has_overlay[v]) updated.push_back(v);
+  }
+
+  // The incoming edges are g's, without the updated vertices as
+  // sources, followed by those with their current edges.  Building
+  // them from scratch scatters every edge at random and costs more
+  // than a full pageRank run on r16.
+  const Graph base = s->g;
+  int *in_count = (int *) malloc(sizeof(int) * numNodes);
+#pragma omp parallel for schedule(static)
+  for (int v = 0; v < numNodes; v++) in_count[v] = incoming_size(base, v);
+  for (Vertex u : updated) {
+    for (const Vertex *w = outgoing_begin(base, u); w != outgoing_end(base, u); w++)
+      in_count[*w]--;
+    for (Vertex w : s->overlay[u]) in_count[w]++;
+  }
+
+  snap->incoming_starts = (int *) malloc(sizeof(int) * numNodes);
+  snap->incoming_edges = (Vertex *) malloc(sizeof(Vertex) * s->num_edges);
+  offset = 0;
+  for (int v = 0; v < numNodes; v++) {
+    snap->incoming_starts[v] = offset;
+    offset += in_count[v];
+  }
+
+  // in_count becomes the fill position
+#pragma omp parallel for schedule(dynamic, CHUNK)
+  for (int v = 0; v < numNodes; v++) {
+    int out = snap->incoming_starts[v];
+    for (const Vertex *u = incoming_begin(base, v); u != incoming_end(base, v); u++)
+      if (!s->has_overlay[*u]) snap->incoming_edges[out++] = *u;
+    in_count[v] = out;
+  }
+  for (Vertex u : updated)
+    for (Vertex w : s->overlay[u]) snap->incoming_edges[in_count[w]++] = u;
+
+  free(in_count);
+  return snap;
+}
+
+void pagerank_stream_free(pagerank_stream *s) {
+  if (s->owns_graph) free_graph(s->g);
+  free(s->solution);
+  free(s->residual);
+  free(s->inv_outdeg);
+  free(s->has_overlay);
+  free(s->on_frontier);
+  free(s->frontier);
+  free(s->next);
+  delete s;
+}
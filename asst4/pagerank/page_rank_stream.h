@@ -0,0 +1,73 @@
+#ifndef __PAGE_RANK_STREAM_H__
+#define __PAGE_RANK_STREAM_H__
+
+#include <stdint.h>
+
+#include <vector>
+
+#include "common/graph.h"
+#include "page_rank.h"
+
+// One edge insertion or deletion
+struct edge_update {
+  Vertex from;
+  Vertex to;
+  bool insert;
+};
+
+// PageRank maintained under a stream of edge updates.  The scores are
+// kept in residual form (score plus the change not yet propagated), so
+// an update only needs to fix up the residuals of the vertices it
+// touches and push from there until the residuals left add up to at
+// most budget.
+struct pagerank_stream {
+  // Base graph: the caller's until the overlay first grows too large,
+  // then a snapshot owned by the stream (owns_graph)
+  Graph g;
+  bool owns_graph;
+  double damping;
+  double convergence;
+  double budget;
+  long num_edges;
+
+  // Unnormalized scores and their pending residuals
+  double* solution;
+  double* residual;
+  double* inv_outdeg;
+
+  // Copy-on-write adjacency: a vertex whose edges were updated gets its
+  // own list in overlay[v] (and has_overlay[v] set); all others still
+  // use their CSR edges in g.  overlay_edges counts the edges in overlay.
+  std::vector<std::vector<Vertex>> overlay;
+  bool* has_overlay;
+  long overlay_edges;
+
+  // Frontier scratch space, kept across batches
+  uint64_t* on_frontier;
+  int* frontier;
+  int* next;
+};
+
+// Computes PageRank of g from scratch.  g must outlive the stream.
+pagerank_stream* pagerank_stream_create(Graph g, double damping,
+                                        double convergence);
+
+// Applies a batch of updates and brings the scores up to date.
+// Inserting an edge that exists or deleting one that doesn't has no
+// effect.  A batch that leaves too much residual to push is finished
+// with pull sweeps over all edges.  If rounds is not NULL, it receives
+// the work done: first entry for applying the updates, then one per
+// push round or sweep.
+void pagerank_stream_apply(pagerank_stream* s, const edge_update* updates,
+                           int count,
+                           std::vector<pr_round_stats>* rounds = NULL);
+
+// Writes the current (normalized) scores to solution
+void pagerank_stream_solution(const pagerank_stream* s, double* solution);
+
+// Builds a standalone graph with the current edges
+Graph pagerank_stream_snapshot(const pagerank_stream* s);
+
+void pagerank_stream_free(pagerank_stream* s);
+
+#endif /* __PAGE_RANK_STREAM_H__ */
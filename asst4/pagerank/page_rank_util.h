@@ -0,0 +1,186 @@
+#ifndef __PAGE_RANK_UTIL_H__
+#define __PAGE_RANK_UTIL_H__
+
+// Helpers shared by the PageRank engines.
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <cmath>
+#include <execution>
+#include <numeric>
+#include <vector>
+
+#include "common/graph.h"
+#include "page_rank.h"
+
+#define CHUNK 100
+
+// Collect the vertices without outgoing edges into node_v.  Returns
+// their number.
+static inline int collect_dangling(Graph g, int *node_v) {
+  int numNodes = num_nodes(g);
+  int *node_bk = (int *) aligned_alloc(sizeof(int), sizeof(int) * numNodes);
+
+#pragma omp parallel for schedule(dynamic, CHUNK)
+  for (int vi = 0; vi < numNodes; ++vi) {
+    // collect nodes with no outgoing edges (in parallel)
+    node_v[vi] = outgoing_size(g, vi) == 0 ? 1 : 0;
+  }
+
+  std::exclusive_scan(std::execution::par_unseq, node_v, node_v + numNodes, node_bk, 0);
+  int numEmptyNodes = node_v[numNodes - 1] + node_bk[numNodes - 1];
+
+  // Collect index inplace
+#pragma omp parallel for schedule(dynamic, CHUNK)
+  for (int vi = 0; vi < numNodes; ++vi)
+    if (node_v[vi] == 1)
+      node_v[node_bk[vi]] = vi;
+  free(node_bk);
+
+  return numEmptyNodes;
+}
+
+// inv_outdeg[v] = 1 / outgoing_size(g, v), or 0 for dangling vertices.
+static inline void compute_inv_outdeg(Graph g, double *inv_outdeg) {
+#pragma omp parallel for schedule(dynamic, CHUNK)
+  for (int vi = 0; vi < num_nodes(g); ++vi) {
+    int outdeg = outgoing_size(g, vi);
+    inv_outdeg[vi] = outdeg == 0 ? 0.0 : 1.0 / outdeg;
+  }
+}
+
+struct vertex_list {
+  int count;
+  int *vertices;
+};
+
+// Atomically replaces *addr with value and returns the previous value.
+static inline double atomic_exchange(double *addr, double value) {
+  uint64_t new_bits, old_bits;
+  memcpy(&new_bits, &value, sizeof(double));
+  old_bits = __sync_lock_test_and_set((uint64_t *) addr, new_bits);
+  double old_value;
+  memcpy(&old_value, &old_bits, sizeof(double));
+  return old_value;
+}
+
+// Atomically adds value to *addr and returns the previous value.
+static inline double atomic_add(double *addr, double value) {
+  uint64_t *bits = (uint64_t *) addr;
+  while (true) {
+    uint64_t old_bits = *bits;
+    double old_value, new_value;
+    memcpy(&old_value, &old_bits, sizeof(double));
+    new_value = old_value + value;
+    uint64_t new_bits;
+    memcpy(&new_bits, &new_value, sizeof(double));
+    if (__sync_bool_compare_and_swap(bits, old_bits, new_bits))
+      return old_value;
+  }
+}
+
+// Whether residual r at a vertex is worth pushing: its share per
+// outgoing edge, what a push costs, is over threshold.  A dangling
+// vertex counts as having one edge.
+static inline bool over_threshold(double r, double inv_outdeg, double threshold) {
+  return std::abs(r) * (inv_outdeg == 0.0 ? 1.0 : inv_outdeg) > threshold;
+}
+
+// out = (solution + residual), normalized to sum to 1.  Dangling mass is
+// never pushed, but redistributing it uniformly only rescales the
+// scores, so normalizing accounts for it.  out may alias solution.
+static inline void fold_residuals(int numNodes, const double *solution,
+                                  const double *residual, double *out) {
+  double total = 0.0;
+#pragma omp parallel for reduction(+:total) schedule(static)
+  for (int vi = 0; vi < numNodes; ++vi) {
+    out[vi] = solution[vi] + residual[vi];
+    total += out[vi];
+  }
+#pragma omp parallel for schedule(static)
+  for (int vi = 0; vi < numNodes; ++vi)
+    out[vi] /= total;
+}
+
+// Runs push rounds until no vertex is left on the frontier.  If
+// edge_budget is not NULL, the edges pushed are taken off *edge_budget,
+// and the rounds stop early, returning false, when the next one would
+// overdraw it.  Stopping early leaves the residuals valid (only less
+// propagated) and on_frontier clear.  The vertices on frontier must
+// have their bit set in on_frontier; next is scratch space of the same
+// size.  out_edges(v) returns the [begin, end) range of v's outgoing
+// edges, and inv_outdeg must match it.
+template <class OutEdges>
+static bool push_residuals(double damping, double threshold,
+                           double *solution, double *residual,
+                           const double *inv_outdeg, uint64_t *on_frontier,
+                           vertex_list *frontier, vertex_list *next,
+                           OutEdges out_edges,
+                           std::vector<pr_round_stats> *rounds,
+                           long *edge_budget = NULL) {
+  while (frontier->count > 0) {
+    if (edge_budget) {
+      long round_edges = 0;
+#pragma omp parallel for reduction(+:round_edges) schedule(static)
+      for (int i = 0; i < frontier->count; i++) {
+        auto [start, end] = out_edges(frontier->vertices[i]);
+        round_edges += end - start;
+      }
+      if (round_edges > *edge_budget) {
+        for (int i = 0; i < frontier->count; i++) {
+          int v = frontier->vertices[i];
+          on_frontier[v >> 6] &= ~(1ull << (v & 63));
+        }
+        return false;
+      }
+    }
+
+    next->count = 0;
+    long edges_processed = 0;
+
+#pragma omp parallel reduction(+:edges_processed)
+    {
+      std::vector<int> pt_frontier;
+
+#pragma omp for schedule(dynamic, CHUNK)
+      for (int i = 0; i < frontier->count; i++) {
+        int v = frontier->vertices[i];
+        // Take whatever has arrived at v so far, including pushes made
+        // earlier in this round.  Clear v's bit first so that later
+        // pushes put it back on the next frontier.
+        __sync_fetch_and_and(on_frontier + (v >> 6), ~(1ull << (v & 63)));
+        double r = atomic_exchange(residual + v, 0.0);
+        solution[v] += r;
+        double delta = damping * r * inv_outdeg[v];
+        auto [start, end] = out_edges(v);
+        edges_processed += end - start;
+
+        for (const Vertex *w = start; w != end; w++) {
+          double r = atomic_add(residual + *w, delta) + delta;
+          uint64_t bit = 1ull << (*w & 63);
+          if (over_threshold(r, inv_outdeg[*w], threshold) && !(on_frontier[*w >> 6] & bit) &&
+              !(__sync_fetch_and_or(on_frontier + (*w >> 6), bit) & bit))
+            pt_frontier.push_back(*w);
+        }
+      }
+
+#pragma omp critical
+      {
+        memcpy(next->vertices + next->count, pt_frontier.data(), pt_frontier.size() * sizeof(int));
+        next->count += pt_frontier.size();
+      }
+    }
+
+    if (rounds) rounds->push_back({frontier->count, edges_processed});
+    if (edge_budget) *edge_budget -= edges_processed;
+
+    vertex_list *tmp = frontier;
+    frontier = next;
+    next = tmp;
+  }
+  return true;
+}
+
+#endif /* __PAGE_RANK_UTIL_H__ */
@@ -0,0 +1,168 @@
+#include <getopt.h>
+#include <omp.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <algorithm>
+#include <iostream>
+#include <random>
+#include <vector>
+
+#include "common/CycleTimer.h"
+#include "common/grade.h"
+#include "common/graph.h"
+#include "page_rank.h"
+
+#define PageRankDampening   0.3f
+#define PageRankConvergence 1e-7d
+
+// Queries per batch to benchmark
+static const int batch_sizes[] = {1, 8, 32};
+
+// Queries checked against one-at-a-time runs
+#define CHECKED_QUERIES 8
+
+void usage(const char* binary_name) {
+  std::cerr << "Usage: " << binary_name
+            << " [-q num_queries] [-s seeds_per_query] [-r seed]"
+               " <path/to/graph/file>\n";
+  std::cerr << "  -q  queries to run per batch size (default: 32)\n";
+  std::cerr << "  -s  seed vertices per query (default: 4)\n";
+  std::cerr << "  -r  random seed (default: 1)\n";
+}
+
+// Writes the teleport vectors of queries [first, first + k) to
+// teleport, interleaved; each query jumps uniformly to its seeds.
+void fill_teleport(int num_nodes, const std::vector<std::vector<int>>& queries,
+                   int first, int k, double* teleport) {
+  std::fill(teleport, teleport + (long)num_nodes * k, 0.0);
+  for (int j = 0; j < k; j++) {
+    const std::vector<int>& seeds = queries[first + j];
+    for (int v : seeds) teleport[(long)v * k + j] += 1.0 / seeds.size();
+  }
+}
+
+int main(int argc, char** argv) {
+  int num_queries = 32;
+  int seeds_per_query = 4;
+  unsigned long seed = 1;
+
+  int opt;
+  while ((opt = getopt(argc, argv, "q:s:r:h")) != EOF) {
+    switch (opt) {
+      case 'q':
+        num_queries = atoi(optarg);
+        break;
+      case 's':
+        seeds_per_query = atoi(optarg);
+        break;
+      case 'r':
+        seed = strtoul(optarg, NULL, 10);
+        break;
+      case 'h':
+      default:
+        usage(argv[0]);
+        exit(1);
+    }
+  }
+
+  if (optind >= argc || num_queries <= 0 || seeds_per_query <= 0) {
+    usage(argv[0]);
+    exit(1);
+  }
+
+  printf("----------------------------------------------------------\n");
+  printf("Max system threads = %d\n", omp_get_max_threads());
+  printf("----------------------------------------------------------\n");
+
+  printf("Loading graph...\n");
+  Graph g = load_graph_binary(argv[optind]);
+  int   n = g->num_nodes;
+  printf("\n");
+  printf("Graph stats:\n");
+  printf("  Edges: %d\n", g->num_edges);
+  printf("  Nodes: %d\n", n);
+  printf("  Queries: %d x %d seeds\n", num_queries, seeds_per_query);
+
+  std::mt19937_64 rng(seed);
+  std::uniform_int_distribution<int> node(0, n - 1);
+  std::vector<std::vector<int>> queries(num_queries);
+  for (std::vector<int>& q : queries)
+    for (int i = 0; i < seeds_per_query; i++) q.push_back(node(rng));
+
+  bool pr_check = true;
+
+  // A uniform teleport vector must give plain PageRank
+  std::cout << "Testing Correctness of Personalized Page Rank\n";
+  double* teleport = (double*)malloc(sizeof(double) * n);
+  double* sol = (double*)malloc(sizeof(double) * n);
+  double* sol_ref = (double*)malloc(sizeof(double) * n);
+  std::fill(teleport, teleport + n, 1.0 / n);
+  personalizedPageRank(g, teleport, sol, PageRankDampening, PageRankConvergence);
+  pageRank(g, sol_ref, PageRankDampening, PageRankConvergence);
+  if (!compareApprox(g, sol_ref, sol)) pr_check = false;
+  free(teleport);
+  free(sol);
+  free(sol_ref);
+
+  // One-at-a-time answers for the first few queries
+  int     checked = std::min(num_queries, CHECKED_QUERIES);
+  double* single = (double*)malloc(sizeof(double) * (long)n * checked);
+  teleport = (double*)malloc(sizeof(double) * n);
+  for (int q = 0; q < checked; q++) {
+    fill_teleport(n, queries, q, 1, teleport);
+    personalizedPageRank(g, teleport, single + (long)q * n, PageRankDampening,
+                         PageRankConvergence);
+  }
+  free(teleport);
+
+  printf("----------------------------------------------------------\n");
+  printf("    K   Batches   Time (s)   Queries/sec   Speedup\n");
+  double base_qps = 0.0;
+  for (int k : batch_sizes) {
+    teleport = (double*)malloc(sizeof(double) * (long)n * k);
+    sol = (double*)malloc(sizeof(double) * (long)n * k);
+
+    double total = 0.0;
+    int    done = 0, batches = 0;
+    while (done < num_queries) {
+      int batch = std::min(k, num_queries - done);
+      fill_teleport(n, queries, done, batch, teleport);
+
+      double start = CycleTimer::currentSeconds();
+      personalizedPageRankBatch(g, batch, teleport, sol, PageRankDampening,
+                                PageRankConvergence);
+      total += CycleTimer::currentSeconds() - start;
+
+      for (int j = 0; j < batch && done + j < checked; j++)
+        for (int v = 0; v < n; v++)
+          if (fabs(sol[(long)v * batch + j] - single[(long)(done + j) * n + v]) >
+              EPSILON) {
+            std::cerr << "*** Batch of " << k << " disagrees on query "
+                      << done + j << " at " << v << std::endl;
+            pr_check = false;
+            break;
+          }
+
+      done += batch;
+      batches++;
+    }
+
+    double qps = num_queries / total;
+    if (k == 1) base_qps = qps;
+    printf("%5d   %7d   %8.4f   %11.2f   %6.2fx\n", k, batches, total, qps,
+           qps / base_qps);
+
+    free(teleport);
+    free(sol);
+  }
+
+  printf("----------------------------------------------------------\n");
+  std::cout << "Correctness: " << std::endl;
+  if (!pr_check) std::cout << "Page Rank is not Correct" << std::endl;
+
+  free(single);
+  delete g;
+
+  return 0;
+}
@@ -0,0 +1,104 @@
+#include <omp.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+
+#include "common/CycleTimer.h"
+#include "common/graph.h"
+#include "common/graph_shards.h"
+#include "page_rank.h"
+
+#define PageRankDampening   0.3f
+#define PageRankConvergence 1e-7d
+
+void usage(const char* binary_name) {
+  std::cerr << "Usage: " << binary_name
+            << " <path/to/shard/file> [path/to/graph/file]\n";
+  std::cerr << "  Runs PageRank out of core over a shard file made with "
+               "'graphTools partition'.\n";
+  std::cerr << "  If the graph file is given, checks the scores against the "
+               "in-memory pageRank.\n";
+}
+
+int main(int argc, char** argv) {
+  if (argc < 2 || argc > 3) {
+    usage(argv[0]);
+    exit(1);
+  }
+
+  printf("----------------------------------------------------------\n");
+  printf("Max system threads = %d\n", omp_get_max_threads());
+  printf("----------------------------------------------------------\n");
+
+  GraphShards shards = open_graph_shards(argv[1]);
+  long max_shard = 0;
+  for (int s = 0; s < shards->num_shards; s++)
+    max_shard = std::max(max_shard, shard_bytes(shards, s));
+
+  // Per-vertex arrays of pageRankShards (solution, two contrib buffers,
+  // inverse degrees and the out-degrees) and the two shard buffers,
+  // next to what load_graph_binary keeps for the same graph
+  double vertex_mb = (sizeof(double) * 4 + sizeof(int)) * (double)shards->num_nodes / 1e6;
+  double resident_mb = vertex_mb + 2 * max_shard / 1e6;
+  double in_memory_mb = sizeof(int) * 2.0 * ((double)shards->num_nodes + shards->num_edges) / 1e6;
+
+  printf("Graph stats:\n");
+  printf("  Edges: %d\n", shards->num_edges);
+  printf("  Nodes: %d\n", shards->num_nodes);
+  printf("  Shards: %d (largest %.1f MB)\n", shards->num_shards, max_shard / 1e6);
+  printf("  Resident: %.1f MB (in-memory graph: %.1f MB)\n", resident_mb,
+         in_memory_mb);
+
+  double* sol_shards = (double*)malloc(sizeof(double) * shards->num_nodes);
+  pr_shard_stats stats;
+
+  double start = CycleTimer::currentSeconds();
+  pageRankShards(shards, sol_shards, PageRankDampening, PageRankConvergence,
+                 &stats);
+  double shards_time = CycleTimer::currentSeconds() - start;
+
+  printf("----------------------------------------------------------\n");
+  printf("Out of core: %.4f s, %d iterations\n", shards_time, stats.iterations);
+  printf("  Read %.1f MB (%.0f MB/s), waited %.4f s for shards\n",
+         stats.bytes_read / 1e6, stats.bytes_read / 1e6 / shards_time,
+         stats.io_wait);
+
+  bool pr_check = true;
+  if (argc == 3) {
+    Graph g = load_graph_binary(argv[2]);
+    if (g->num_nodes != shards->num_nodes || g->num_edges != shards->num_edges) {
+      fprintf(stderr, "Shard file does not match the graph.\n");
+      exit(1);
+    }
+
+    double* sol_mem = (double*)malloc(sizeof(double) * g->num_nodes);
+    start = CycleTimer::currentSeconds();
+    pageRank(g, sol_mem, PageRankDampening, PageRankConvergence);
+    double mem_time = CycleTimer::currentSeconds() - start;
+
+    double max_diff = 0.0;
+    int differ = 0;
+    for (int v = 0; v < g->num_nodes; v++) {
+      if (sol_shards[v] != sol_mem[v]) differ++;
+      max_diff = std::max(max_diff, std::fabs(sol_shards[v] - sol_mem[v]));
+    }
+    pr_check = max_diff < 1e-11;
+
+    printf("In memory:   %.4f s\n", mem_time);
+    printf("  %d of %d scores differ, max diff %g\n", differ, g->num_nodes,
+           max_diff);
+    free(sol_mem);
+    free_graph(g);
+  }
+
+  printf("----------------------------------------------------------\n");
+  std::cout << "Correctness: " << std::endl;
+  if (!pr_check) std::cout << "Page Rank is not Correct" << std::endl;
+
+  free(sol_shards);
+  close_graph_shards(shards);
+  return 0;
+}
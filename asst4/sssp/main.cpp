@@ -0,0 +1,168 @@
+#include <getopt.h>
+#include <omp.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "common/CycleTimer.h"
+#include "common/benchmark.h"
+#include "common/graph.h"
+#include "sssp.h"
+
+void usage(const char* binary_name) {
+  std::cerr << "Usage: " << binary_name
+            << " [options] <path/to/graph/file> [num_threads]\n";
+  std::cerr << "  To run results for all thread counts: <path/to/graph/file>\n";
+  std::cerr << "  Run with a certain number of threads: "
+               "<path/to/graph/file> <num_threads>\n";
+  std::cerr << "\n";
+  std::cerr << "Options:\n";
+  std::cerr << "  -d  INT bucket width (default: average edge weight)\n";
+  std::cerr << "  -s  INT source vertex (default: 0)\n";
+  std::cerr << "  -h      this commandline help message\n";
+}
+
+int main(int argc, char** argv) {
+  int delta  = -1;
+  int source = 0;
+
+  int opt;
+  while ((opt = getopt(argc, argv, "d:s:h")) != EOF) {
+    switch (opt) {
+      case 'd':
+        delta = atoi(optarg);
+        break;
+      case 's':
+        source = atoi(optarg);
+        break;
+      case 'h':
+      default:
+        usage(argv[0]);
+        exit(1);
+    }
+  }
+
+  if (optind >= argc) {
+    usage(argv[0]);
+    exit(1);
+  }
+
+  int thread_count = -1;
+  if (optind + 1 < argc) {
+    thread_count = atoi(argv[optind + 1]);
+  }
+
+  printf("----------------------------------------------------------\n");
+  printf("Max system threads = %d\n", omp_get_max_threads());
+  if (thread_count > 0) {
+    thread_count = std::min(thread_count, omp_get_max_threads());
+    printf("Running with %d threads\n", thread_count);
+  }
+  printf("----------------------------------------------------------\n");
+
+  printf("Loading graph...\n");
+  Graph g = load_graph_binary(argv[optind]);
+  printf("\n");
+  printf("Graph stats:\n");
+  printf("  Edges: %d\n", g->num_edges);
+  printf("  Nodes: %d\n", g->num_nodes);
+  printf("  Weighted: %s\n", g->outgoing_weights ? "yes" : "no");
+
+  if (source < 0 || source >= g->num_nodes) {
+    fprintf(stderr, "Invalid source vertex %d\n", source);
+    exit(1);
+  }
+
+  if (delta <= 0) {
+    long total_weight = g->num_edges;
+    if (g->outgoing_weights) {
+      total_weight = 0;
+      for (int e = 0; e < g->num_edges; e++)
+        total_weight += g->outgoing_weights[e];
+    }
+    delta = g->num_edges ? std::max(1L, total_weight / g->num_edges) : 1;
+  }
+  printf("  Delta: %d\n", delta);
+
+  std::vector<int> num_threads;
+  if (thread_count <= -1) {
+    num_threads = bench_thread_counts(omp_get_max_threads());
+  } else {
+    num_threads.push_back(thread_count);
+  }
+  int n_usage = num_threads.size();
+
+  int* sol = (int*)malloc(sizeof(int) * g->num_nodes);
+  int* ref = (int*)malloc(sizeof(int) * g->num_nodes);
+
+  // The reference is serial, so it only needs to run once.
+  double start = CycleTimer::currentSeconds();
+  reference_sssp(g, source, ref);
+  double ref_time = CycleTimer::currentSeconds() - start;
+
+  double sssp_base, sssp_time;
+
+  std::stringstream timing;
+  std::stringstream relative_timing;
+
+  bool sssp_check = true;
+
+  timing << "Threads  Delta-Stepping\n";
+  relative_timing << "Threads  Speedup\n";
+
+  for (int i = 0; i < n_usage; i++) {
+    printf("----------------------------------------------------------\n");
+    std::cout << "Running with " << num_threads[i] << " threads" << std::endl;
+    omp_set_num_threads(num_threads[i]);
+
+    start = CycleTimer::currentSeconds();
+    sssp_delta_stepping(g, source, delta, sol);
+    sssp_time = CycleTimer::currentSeconds() - start;
+
+    std::cout << "Testing Correctness of Delta-Stepping\n";
+    for (int j = 0; j < g->num_nodes; j++) {
+      if (sol[j] != ref[j]) {
+        fprintf(stderr, "*** Results disagree at %d: %d, %d\n", j, sol[j],
+                ref[j]);
+        sssp_check = false;
+        break;
+      }
+    }
+
+    if (i == 0) sssp_base = sssp_time;
+
+    char buf[1024];
+    char relative_buf[1024];
+
+    sprintf(buf, "%4d:    %.4f (%.2fx)\n", num_threads[i], sssp_time,
+            sssp_base / sssp_time);
+    sprintf(relative_buf, "%4d:     %.2fx\n", num_threads[i],
+            ref_time / sssp_time);
+
+    timing << buf;
+    relative_timing << relative_buf;
+  }
+
+  printf("----------------------------------------------------------\n");
+  std::cout << "Your Code: Timing Summary" << std::endl;
+  std::cout << timing.str();
+  printf("----------------------------------------------------------\n");
+  std::cout << "Serial Dijkstra: Timing Summary" << std::endl;
+  printf("        %.4f\n", ref_time);
+  printf("----------------------------------------------------------\n");
+  std::cout << "Correctness: " << std::endl;
+  if (!sssp_check) std::cout << "Delta-Stepping is not Correct" << std::endl;
+  std::cout << std::endl
+            << "Speedup vs. Serial Dijkstra: " << std::endl
+            << relative_timing.str();
+
+  free(sol);
+  free(ref);
+  free_graph(g);
+
+  return 0;
+}
@@ -0,0 +1,34 @@
+#include <functional>
+#include <queue>
+#include <utility>
+#include <vector>
+
+#include "sssp.h"
+
+void reference_sssp(Graph g, Vertex source, int *distances) {
+  using entry = std::pair<int, Vertex>;
+  std::priority_queue<entry, std::vector<entry>, std::greater<entry>> queue;
+
+  for (int v = 0; v < g->num_nodes; v++) distances[v] = SSSP_INFINITY;
+  distances[source] = 0;
+  queue.push({0, source});
+
+  while (!queue.empty()) {
+    entry top = queue.top();
+    queue.pop();
+    int u = top.second;
+    if (top.first != distances[u]) continue;
+
+    int start_edge = g->outgoing_starts[u];
+    int end_edge = (u == g->num_nodes - 1) ? g->num_edges
+                                           : g->outgoing_starts[u + 1];
+    for (int e = start_edge; e < end_edge; e++) {
+      int v = g->outgoing_edges[e];
+      int w = g->outgoing_weights ? g->outgoing_weights[e] : 1;
+      if (distances[u] + w < distances[v]) {
+        distances[v] = distances[u] + w;
+        queue.push({distances[v], v});
+      }
+    }
+  }
+}
@@ -0,0 +1,148 @@
+#include "sssp.h"
+
+#include <omp.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <vector>
+
+#include "../common/graph.h"
+
+#define CHUNK    500
+#define NO_BUCKET INT_MAX
+
+using bucket_list = std::vector<std::vector<Vertex>>;
+
+// Relax edge (u, v) of weight w.  On success v is filed into the
+// thread-local bucket matching its new distance.
+static inline void relax(Vertex u, Vertex v, int w, int delta, int *distances,
+                         bucket_list &buckets) {
+  int new_dist = distances[u] + w;
+  int old_dist = distances[v];
+  while (new_dist < old_dist) {
+    if (__sync_bool_compare_and_swap(distances + v, old_dist, new_dist)) {
+      size_t bucket = new_dist / delta;
+      if (bucket >= buckets.size()) buckets.resize(bucket + 1);
+      buckets[bucket].push_back(v);
+      return;
+    }
+    old_dist = distances[v];
+  }
+}
+
+// Relax either the light (weight <= delta) or the heavy edges of u.
+static inline void relax_edges(Graph g, Vertex u, bool light, int delta,
+                               int *distances, bucket_list &buckets) {
+  int start_edge = g->outgoing_starts[u];
+  int end_edge = (u == g->num_nodes - 1) ? g->num_edges
+                                         : g->outgoing_starts[u + 1];
+  const Weight *weights = g->outgoing_weights;
+
+  for (int e = start_edge; e < end_edge; e++) {
+    int w = weights ? weights[e] : 1;
+    if ((w <= delta) == light)
+      relax(u, g->outgoing_edges[e], w, delta, distances, buckets);
+  }
+}
+
+void sssp_delta_stepping(Graph g, Vertex source, int delta, int *distances) {
+  int max_threads = omp_get_max_threads();
+
+  // Buckets are thread-local; the frontier is the concatenation of all
+  // threads' copies of the current bucket.
+  std::vector<bucket_list> buckets(max_threads);
+  std::vector<std::vector<Vertex>> settled(max_threads);
+  std::vector<size_t> offsets(max_threads + 1);
+  std::vector<Vertex> frontier;
+  int *is_settled = (int *) malloc(sizeof(int) * g->num_nodes);
+
+#pragma omp parallel for schedule(dynamic, CHUNK)
+  for (int i = 0; i < g->num_nodes; i++) {
+    distances[i] = SSSP_INFINITY;
+    is_settled[i] = 0;
+  }
+
+  distances[source] = 0;
+  frontier.push_back(source);
+  size_t current = 0;
+  size_t next_bucket;
+
+#pragma omp parallel
+  {
+    int tid = omp_get_thread_num();
+    int num_threads = omp_get_num_threads();
+    bucket_list &local_buckets = buckets[tid];
+    std::vector<Vertex> &local_settled = settled[tid];
+
+    while (!frontier.empty()) {
+      // Light phase: relax light edges of everything in the current
+      // bucket.  Entries whose distance has since dropped into an
+      // earlier bucket are stale and skipped.
+#pragma omp for schedule(dynamic, 64)
+      for (size_t i = 0; i < frontier.size(); i++) {
+        Vertex u = frontier[i];
+        if ((size_t) (distances[u] / delta) != current) continue;
+        if (!is_settled[u] &&
+            __sync_bool_compare_and_swap(is_settled + u, 0, 1))
+          local_settled.push_back(u);
+        relax_edges(g, u, true, delta, distances, local_buckets);
+      }
+
+#pragma omp single
+      {
+        next_bucket = current;
+        bool empty = true;
+        for (int t = 0; t < num_threads; t++)
+          if (current < buckets[t].size() && !buckets[t][current].empty())
+            empty = false;
+        if (empty) next_bucket = NO_BUCKET;
+      }
+
+      // Heavy phase: the current bucket is drained, so distances of
+      // its vertices are final.  Heavy edges can only reach later
+      // buckets, so one relaxation per settled vertex suffices.
+      if (next_bucket == NO_BUCKET) {
+        for (Vertex u : local_settled)
+          relax_edges(g, u, false, delta, distances, local_buckets);
+        local_settled.clear();
+
+#pragma omp barrier
+#pragma omp single
+        {
+          for (int t = 0; t < num_threads; t++) {
+            for (size_t b = current + 1; b < buckets[t].size(); b++) {
+              if (!buckets[t][b].empty()) {
+                if (b < next_bucket) next_bucket = b;
+                break;
+              }
+            }
+          }
+        }
+      }
+
+      // Gather the next bucket from all threads into the frontier.
+#pragma omp single
+      {
+        offsets[0] = 0;
+        for (int t = 0; t < num_threads; t++) {
+          size_t count = next_bucket < buckets[t].size()
+                             ? buckets[t][next_bucket].size()
+                             : 0;
+          offsets[t + 1] = offsets[t] + count;
+        }
+        frontier.resize(offsets[num_threads]);
+        current = next_bucket;
+      }
+
+      if (current < local_buckets.size()) {
+        std::vector<Vertex> &bucket = local_buckets[current];
+        memcpy(frontier.data() + offsets[tid], bucket.data(),
+               bucket.size() * sizeof(Vertex));
+        bucket.clear();
+      }
+#pragma omp barrier
+    }
+  }
+
+  free(is_settled);
+}
@@ -0,0 +1,25 @@
+#ifndef __SSSP_H__
+#define __SSSP_H__
+
+#include <limits.h>
+
+#include "common/graph.h"
+
+// Distance of vertices that are unreachable from the source.
+#define SSSP_INFINITY INT_MAX
+
+// Unweighted graphs are treated as if every edge had weight 1.
+
+// Delta-stepping single source shortest paths.  Vertices are kept in
+// buckets of width delta; edges of weight <= delta ("light") are
+// relaxed repeatedly while a bucket is processed, heavier edges once
+// per settled vertex after the bucket is empty.
+//
+// On return distances[v] holds the length of the shortest path from
+// source to v, or SSSP_INFINITY.
+void sssp_delta_stepping(Graph g, Vertex source, int delta, int* distances);
+
+// Serial Dijkstra, used as the correctness reference.
+void reference_sssp(Graph g, Vertex source, int* distances);
+
+#endif /* __SSSP_H__ */
@@ -0,0 +1,100 @@
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <algorithm>
+#include <iostream>
+#include <random>
+#include <vector>
+
+#include "../common/CycleTimer.h"
+#include "../common/graph.h"
+#include "../common/simd_gather.h"
+
+// Compares the scalar and SIMD versions of the sparse edge kernels on
+// the incoming edges of a graph:
+//
+//   gather:     sum of values[u] over the in-neighbors u of every vertex
+//               (the PageRank pull loop)
+//   find_first: first in-neighbor u with level[u] == key (the
+//               bottom-up BFS search)
+
+void usage(const char* binary_name) {
+  std::cerr << "Usage: " << binary_name
+            << " graph.bin [repetitions] [hit_percent]\n";
+  std::cerr << "  hit_percent: share of vertices find_first looks for "
+               "(default: 10)\n";
+}
+
+int main(int argc, char** argv) {
+  if (argc < 2) {
+    usage(argv[0]);
+    exit(1);
+  }
+  int reps = argc > 2 ? atoi(argv[2]) : 5;
+  int hit_percent = argc > 3 ? atoi(argv[3]) : 10;
+
+  Graph g = load_graph_binary(argv[1]);
+  int   n = num_nodes(g);
+  printf("Graph: %d nodes, %d edges\n", n, num_edges(g));
+  printf("Best ISA: %s\n", simd_isa_name(simd_detect()));
+
+  std::mt19937_64 rng(1);
+  std::uniform_real_distribution<double> uniform(0.0, 1.0);
+  std::vector<double> values(n);
+  std::vector<int>    level(n);
+  for (int v = 0; v < n; v++) {
+    values[v] = uniform(rng);
+    level[v] = uniform(rng) * 100 < hit_percent ? 1 : 0;
+  }
+
+  // Repetitions alternate between the ISAs so that all of them see the
+  // same machine conditions; the best time of each is reported.
+  int num_isas = simd_detect() + 1;
+  std::vector<double> gather_time(num_isas, 1e30), find_time(num_isas, 1e30);
+  std::vector<std::vector<double>> sums(num_isas, std::vector<double>(n));
+  std::vector<std::vector<int>>    found(num_isas, std::vector<int>(n));
+  long scanned = 0;
+
+  for (int r = 0; r < reps; r++) {
+    for (int isa = 0; isa < num_isas; isa++) {
+      gather_sum_fn gather = gather_sum_for((simd_isa)isa);
+      find_first_fn find = find_first_for((simd_isa)isa);
+      double* out = sums[isa].data();
+      int*    pos = found[isa].data();
+
+      double start = CycleTimer::currentSeconds();
+      for (int v = 0; v < n; v++)
+        out[v] = gather(values.data(), incoming_begin(g, v), incoming_size(g, v));
+      gather_time[isa] = std::min(gather_time[isa], CycleTimer::currentSeconds() - start);
+
+      start = CycleTimer::currentSeconds();
+      for (int v = 0; v < n; v++)
+        pos[v] = find(level.data(), incoming_begin(g, v), incoming_size(g, v), 1);
+      find_time[isa] = std::min(find_time[isa], CycleTimer::currentSeconds() - start);
+    }
+  }
+
+  for (int v = 0; v < n; v++)
+    scanned += std::min(found[0][v] + 1, incoming_size(g, v));
+
+  for (int isa = 1; isa < num_isas; isa++) {
+    for (int v = 0; v < n; v++) {
+      if (fabs(sums[isa][v] - sums[0][v]) > 1e-12 * fabs(sums[0][v]) ||
+          found[isa][v] != found[0][v]) {
+        fprintf(stderr, "*** %s disagrees with scalar at vertex %d\n",
+                simd_isa_name((simd_isa)isa), v);
+        exit(1);
+      }
+    }
+  }
+
+  printf("ISA       gather ns/edge  speedup   find_first ns/edge  speedup\n");
+  for (int isa = 0; isa < num_isas; isa++)
+    printf("%-8s  %14.3f  %6.2fx   %18.3f  %6.2fx\n", simd_isa_name((simd_isa)isa),
+           gather_time[isa] * 1e9 / num_edges(g), gather_time[0] / gather_time[isa],
+           find_time[isa] * 1e9 / scanned, find_time[0] / find_time[isa]);
+
+  delete g;
+  return 0;
+}
@@ -0,0 +1,199 @@
+#include "generator.h"
+
+#include <limits.h>
+#include <omp.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <algorithm>
+
+// Graph500 initiator matrix
+#define RMAT_A 0.57
+#define RMAT_B 0.19
+#define RMAT_C 0.19
+
+// splitmix64 finalizer; used as a counter-based random number
+// generator so that every edge can be generated independently.
+static inline uint64_t mix64(uint64_t x) {
+  x += 0x9E3779B97F4A7C15ull;
+  x = (x ^ (x >> 30)) * 0xBF58476D1CE4E5B9ull;
+  x = (x ^ (x >> 27)) * 0x94D049BB133111EBull;
+  return x ^ (x >> 31);
+}
+
+static inline double to_unit(uint64_t x) {
+  return (x >> 11) * (1.0 / 9007199254740992.0);
+}
+
+// A bijection on [0, 2^scale) built from invertible steps (odd
+// multiplications and xor-shifts modulo 2^scale).
+static inline uint64_t scramble(uint64_t v, int scale, uint64_t seed) {
+  uint64_t mask = (scale == 64) ? ~0ull : (1ull << scale) - 1;
+  uint64_t k1 = (mix64(seed) | 1);
+  uint64_t k2 = (mix64(seed + 1) | 1);
+  v = (v * k1) & mask;
+  v ^= v >> (scale / 2 + 1);
+  v = (v * k2) & mask;
+  v ^= v >> (scale / 3 + 1);
+  return v;
+}
+
+// Draw edge number e: one quadrant choice per level of the recursion.
+static inline void rmat_edge(uint64_t e, int scale, uint64_t seed,
+                             uint64_t* src, uint64_t* dst) {
+  uint64_t u = 0, v = 0;
+  uint64_t base = mix64(seed ^ mix64(e));
+  for (int level = 0; level < scale; level++) {
+    double r = to_unit(mix64(base + level));
+    u <<= 1;
+    v <<= 1;
+    if (r < RMAT_A) {
+    } else if (r < RMAT_A + RMAT_B) {
+      v |= 1;
+    } else if (r < RMAT_A + RMAT_B + RMAT_C) {
+      u |= 1;
+    } else {
+      u |= 1;
+      v |= 1;
+    }
+  }
+  *src = scramble(u, scale, seed);
+  *dst = scramble(v, scale, seed);
+}
+
+// In-place exclusive prefix sum over counts[0..n]; returns the total.
+static int64_t prefix_sum(int64_t* counts, int64_t n) {
+  int      num_threads = omp_get_max_threads();
+  int64_t* partial     = (int64_t*)calloc(num_threads + 1, sizeof(int64_t));
+
+#pragma omp parallel num_threads(num_threads)
+  {
+    int     tid   = omp_get_thread_num();
+    int64_t begin = n * tid / num_threads;
+    int64_t end   = n * (tid + 1) / num_threads;
+
+    int64_t sum = 0;
+    for (int64_t i = begin; i < end; i++) sum += counts[i];
+    partial[tid + 1] = sum;
+
+#pragma omp barrier
+#pragma omp single
+    for (int t = 0; t < num_threads; t++) partial[t + 1] += partial[t];
+
+    sum = partial[tid];
+    for (int64_t i = begin; i < end; i++) {
+      int64_t count = counts[i];
+      counts[i]     = sum;
+      sum += count;
+    }
+  }
+
+  int64_t total = partial[num_threads];
+  counts[n]     = total;
+  free(partial);
+  return total;
+}
+
+Graph generate_rmat(int scale, int edge_factor, uint64_t seed, bool symmetric,
+                    int max_weight) {
+  // Edge offsets of the graph format are ints, so every generated edge
+  // (both copies if symmetric) has to fit before dropping duplicates:
+  // scale 26 at edge factor 16, 25 if symmetric.
+  int64_t per_node  = (int64_t)edge_factor * (symmetric ? 2 : 1);
+  int     max_scale = 0;
+  while (max_scale < 30 && (per_node << (max_scale + 1)) <= INT_MAX)
+    max_scale++;
+  if (edge_factor < 1 || scale < 1 || scale > max_scale) {
+    fprintf(stderr,
+            "Scale must be between 1 and %d for edge factor %d%s (at most "
+            "%d edges).\n",
+            max_scale, edge_factor, symmetric ? ", symmetric" : "", INT_MAX);
+    exit(1);
+  }
+
+  int64_t num_nodes     = 1ll << scale;
+  int64_t num_generated = num_nodes * edge_factor;
+  int64_t num_stored    = num_generated * (symmetric ? 2 : 1);
+
+  int64_t* starts = (int64_t*)calloc(num_nodes + 1, sizeof(int64_t));
+  Vertex*  edges  = (Vertex*)malloc(sizeof(Vertex) * num_stored);
+  if (!starts || !edges) {
+    fprintf(stderr, "Out of memory generating %lld edges.\n",
+            (long long)num_stored);
+    exit(1);
+  }
+
+  // Pass 1: count out-degrees.  Edges are regenerated in pass 2 instead
+  // of being stored, which halves the peak memory.
+#pragma omp parallel for schedule(static)
+  for (int64_t e = 0; e < num_generated; e++) {
+    uint64_t u, v;
+    rmat_edge(e, scale, seed, &u, &v);
+    if (u == v) continue;
+    __sync_fetch_and_add(&starts[u], 1);
+    if (symmetric) __sync_fetch_and_add(&starts[v], 1);
+  }
+  prefix_sum(starts, num_nodes);
+
+  // Pass 2: scatter.  The order within an adjacency list depends on
+  // scheduling, but lists are sorted below.
+  int64_t* fill = (int64_t*)malloc(sizeof(int64_t) * num_nodes);
+#pragma omp parallel for schedule(static)
+  for (int64_t i = 0; i < num_nodes; i++) fill[i] = starts[i];
+
+#pragma omp parallel for schedule(static)
+  for (int64_t e = 0; e < num_generated; e++) {
+    uint64_t u, v;
+    rmat_edge(e, scale, seed, &u, &v);
+    if (u == v) continue;
+    edges[__sync_fetch_and_add(&fill[u], 1)] = (Vertex)v;
+    if (symmetric) edges[__sync_fetch_and_add(&fill[v], 1)] = (Vertex)u;
+  }
+
+  // Sort and deduplicate every adjacency list; fill[i] becomes its new
+  // length.
+#pragma omp parallel for schedule(dynamic, 1024)
+  for (int64_t i = 0; i < num_nodes; i++) {
+    Vertex* begin = edges + starts[i];
+    Vertex* end   = edges + starts[i + 1];
+    std::sort(begin, end);
+    fill[i] = std::unique(begin, end) - begin;
+  }
+
+  int64_t* new_starts = (int64_t*)malloc(sizeof(int64_t) * (num_nodes + 1));
+#pragma omp parallel for schedule(static)
+  for (int64_t i = 0; i < num_nodes; i++) new_starts[i] = fill[i];
+  int64_t total = prefix_sum(new_starts, num_nodes);
+
+  graph* g           = (struct graph*)malloc(sizeof(struct graph));
+  g->num_nodes       = (int)num_nodes;
+  g->num_edges       = (int)total;
+  g->outgoing_starts = (int*)malloc(sizeof(int) * num_nodes);
+  g->outgoing_edges  = (Vertex*)malloc(sizeof(Vertex) * total);
+  g->outgoing_weights =
+      max_weight > 0 ? (Weight*)malloc(sizeof(Weight) * total) : NULL;
+  g->incoming_starts = NULL;
+  g->incoming_edges  = NULL;
+
+#pragma omp parallel for schedule(dynamic, 1024)
+  for (int64_t i = 0; i < num_nodes; i++) {
+    int64_t out = new_starts[i];
+    g->outgoing_starts[i] = (int)out;
+    for (int64_t j = 0; j < fill[i]; j++) {
+      Vertex v                 = edges[starts[i] + j];
+      g->outgoing_edges[out + j] = v;
+      if (max_weight > 0) {
+        // Hash the unordered pair so both directions agree
+        uint64_t lo = std::min<int64_t>(i, v), hi = std::max<int64_t>(i, v);
+        g->outgoing_weights[out + j] =
+            1 + mix64(seed ^ mix64((hi << 32) | lo)) % (uint64_t)max_weight;
+      }
+    }
+  }
+
+  free(starts);
+  free(edges);
+  free(fill);
+  free(new_starts);
+  return g;
+}
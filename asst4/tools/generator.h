@@ -0,0 +1,27 @@
+#ifndef __GENERATOR_H__
+#define __GENERATOR_H__
+
+#include <stdint.h>
+
+#include "../common/graph.h"
+
+// Graph500 R-MAT/Kronecker generator.
+//
+// Produces 2^scale vertices and edge_factor * 2^scale generated edges
+// with the Graph500 initiator probabilities (A=0.57, B=0.19, C=0.19).
+// Vertex ids are scrambled so that high degree vertices are not
+// clustered at low ids.  Self loops and duplicate edges are dropped.
+// If symmetric is set every edge is stored in both directions; if
+// max_weight > 0 every edge gets a weight in [1, max_weight] (the same
+// in both directions).  All generated edges have to fit in the int
+// offsets of the graph format, which limits the scale to 26 at edge
+// factor 16 (25 if symmetric); larger requests exit with an error
+// before anything is allocated.
+//
+// Generation runs in parallel and the result only depends on the
+// arguments, not on the number of threads.  Only the outgoing half of
+// the graph is built; the result is meant for store_graph_binary.
+Graph generate_rmat(int scale, int edge_factor, uint64_t seed, bool symmetric,
+                    int max_weight);
+
+#endif /* __GENERATOR_H__ */
@@ -1,12 +1,16 @@
 
 #include <algorithm>
 #include <climits>
+#include <cstdint>
 #include <iomanip>
 #include <iostream>
 #include <string>
 #include <vector>
 
+#include "../common/CycleTimer.h"
 #include "../common/graph.h"
+#include "../common/graph_shards.h"
+#include "generator.h"
 
 #define CMD_TEXT2BIN   "text2bin"
 #define CMD_INFO       "info"
@@ -14,6 +18,9 @@
 #define CMD_NOOUTEDGES "noout"
 #define CMD_NOINEDGES  "noin"
 #define CMD_EDGESTATS  "edgestats"
+#define CMD_ADDWEIGHTS "addweights"
+#define CMD_GENERATE   "generate"
+#define CMD_PARTITION  "partition"
 
 void print_help(const char* binary_name) {
   std::cerr << "Usage: " << binary_name << " cmd args\n";
@@ -28,7 +35,21 @@ void print_help(const char* binary_name) {
       << CMD_NOOUTEDGES << ": detect vertices with no outgoing edges\n"
       << CMD_NOINEDGES << ": detect vertices with no incoming edges\n"
       << CMD_EDGESTATS
-      << ": print stats on graph edges: e.g., min/max edges per node, etc.\n";
+      << ": print stats on graph edges: e.g., min/max edges per node, etc.\n"
+      << CMD_ADDWEIGHTS << ": attach random edge weights to a binary graph\n"
+      << CMD_GENERATE
+      << ": generate a Graph500-style R-MAT graph in binary format\n"
+      << CMD_PARTITION
+      << ": split a binary graph into shards for out-of-core processing\n";
+}
+
+// splitmix64: a cheap, stateless hash used to derive per-edge random
+// numbers, so that the output only depends on the seed.
+static inline uint64_t mix64(uint64_t x) {
+  x += 0x9E3779B97F4A7C15ull;
+  x = (x ^ (x >> 30)) * 0xBF58476D1CE4E5B9ull;
+  x = (x ^ (x >> 27)) * 0x94D049BB133111EBull;
+  return x ^ (x >> 31);
 }
 
 int main(int argc, char** argv) {
@@ -74,6 +95,8 @@ int main(int argc, char** argv) {
 
     std::cout << "Num vertices: " << num_nodes(g) << "\n";
     std::cout << "Num edges:    " << num_edges(g) << "\n";
+    std::cout << "Weighted:     " << (g->outgoing_weights ? "yes" : "no")
+              << "\n";
     delete g;
 
   } else if (!cmd.compare(CMD_PRINT)) {
@@ -260,6 +283,99 @@ int main(int argc, char** argv) {
     std::cout << "Incoming edges: total=" << total_incoming
               << " avg=" << avg_incoming << " min=" << min_incoming
               << " max=" << max_incoming << "\n";
+  } else if (!cmd.compare(CMD_ADDWEIGHTS)) {
+    if (argc < 4) {
+      std::cerr << "Usage: " << argv[0] << " " << cmd
+                << " infilename outfilename [max_weight] [seed]\n";
+      std::cerr << "Assigns every edge a uniform random weight in "
+                   "[1, max_weight] (default 255) and stores the weighted "
+                   "graph in binary format\n";
+      exit(1);
+    }
+
+    std::string inputFilename  = std::string(argv[2]);
+    std::string outputFilename = std::string(argv[3]);
+    int         max_weight     = (argc > 4) ? atoi(argv[4]) : 255;
+    uint64_t    seed           = (argc > 5) ? strtoull(argv[5], NULL, 10) : 1;
+
+    Graph g;
+    std::cout << "Loading graph: " << inputFilename << "\n";
+    g = load_graph_binary(inputFilename.c_str());
+    std::cout << "Done loading.\n";
+
+    free(g->outgoing_weights);
+    g->outgoing_weights = (Weight*)malloc(sizeof(Weight) * num_edges(g));
+    for (int i = 0; i < num_edges(g); i++) {
+      g->outgoing_weights[i] = 1 + mix64(seed * 0x100000001B3ull + i) %
+                                       static_cast<uint64_t>(max_weight);
+    }
+
+    store_graph_binary(outputFilename.c_str(), g);
+    free_graph(g);
+  } else if (!cmd.compare(CMD_GENERATE)) {
+    if (argc < 5) {
+      std::cerr << "Usage: " << argv[0] << " " << cmd
+                << " scale edgefactor binfilename [seed] [symmetric] "
+                   "[max_weight]\n";
+      std::cerr << "Generates an R-MAT graph with 2^scale vertices and "
+                   "edgefactor * 2^scale edges\n"
+                   "(before removing self loops and duplicates).  Pass 1 "
+                   "as symmetric to store\nevery edge in both directions, "
+                   "and a positive max_weight for a weighted graph.\n"
+                   "At most 2^31 - 1 edges are generated, counting both "
+                   "directions: scale <= 26\nat edgefactor 16, 25 if "
+                   "symmetric.\n";
+      exit(1);
+    }
+
+    int         scale          = atoi(argv[2]);
+    int         edge_factor    = atoi(argv[3]);
+    std::string outputFilename = std::string(argv[4]);
+    uint64_t    seed       = (argc > 5) ? strtoull(argv[5], NULL, 10) : 1;
+    bool        symmetric  = (argc > 6) ? atoi(argv[6]) != 0 : false;
+    int         max_weight = (argc > 7) ? atoi(argv[7]) : 0;
+
+    std::cout << "Generating R-MAT graph: scale=" << scale
+              << " edgefactor=" << edge_factor << " seed=" << seed
+              << (symmetric ? " symmetric" : "") << "\n";
+    double start = CycleTimer::currentSeconds();
+    Graph  g = generate_rmat(scale, edge_factor, seed, symmetric, max_weight);
+    std::cout << "Done generating in "
+              << CycleTimer::currentSeconds() - start << " sec.\n";
+    std::cout << "Num vertices: " << num_nodes(g) << "\n";
+    std::cout << "Num edges:    " << num_edges(g) << "\n";
+
+    store_graph_binary(outputFilename.c_str(), g);
+    free_graph(g);
+  } else if (!cmd.compare(CMD_PARTITION)) {
+    if (argc < 4) {
+      std::cerr << "Usage: " << argv[0] << " " << cmd
+                << " binfilename shardfilename [num_shards]\n";
+      std::cerr << "Splits a binary graph into num_shards (default 8) shards "
+                   "of incoming edges\nby destination vertex, without "
+                   "loading the whole graph into memory\n";
+      exit(1);
+    }
+
+    std::string inputFilename  = std::string(argv[2]);
+    std::string outputFilename = std::string(argv[3]);
+    int         num_shards     = (argc > 4) ? atoi(argv[4]) : 8;
+
+    std::cout << "Partitioning graph: " << inputFilename << "\n";
+    double start = CycleTimer::currentSeconds();
+    partition_graph_binary(inputFilename.c_str(), outputFilename.c_str(),
+                           num_shards);
+    std::cout << "Done partitioning in "
+              << CycleTimer::currentSeconds() - start << " sec.\n";
+
+    GraphShards shards = open_graph_shards(outputFilename.c_str());
+    for (int s = 0; s < shards->num_shards; s++) {
+      std::cout << "Shard " << s << ": vertices " << shards->shard_starts[s]
+                << ".." << shards->shard_starts[s + 1] - 1 << ", "
+                << shards->shard_edges[s + 1] - shards->shard_edges[s]
+                << " edges, " << shard_bytes(shards, s) << " bytes\n";
+    }
+    close_graph_shards(shards);
   }
 
   else {
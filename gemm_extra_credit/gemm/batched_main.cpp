@@ -0,0 +1,168 @@
+#include <getopt.h>
+#include <math.h>
+#include <omp.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <algorithm>
+#include <vector>
+
+#include "CycleTimer.h"
+#include "gemm.h"
+
+#define N_ITERS 5  // how many times to run each implementation for timing
+
+// Data of all three operands of a batch, in bytes, when no batch size
+// is given: well past the last level cache
+#define DEFAULT_BATCH_BYTES (256L << 20)
+
+static const int sizes[] = {2, 3, 4, 5, 6, 7, 8, 10, 12, 16, 24, 32, 48};
+
+static void naiveGemm(int m, int n, int k, const double *A, const double *B,
+                      double *C, double alpha, double beta) {
+  for (int i = 0; i < m; i++) {
+    for (int j = 0; j < n; j++) {
+      double sum = 0.0;
+      for (int p = 0; p < k; p++) sum += A[i * k + p] * B[p * n + j];
+      C[i * n + j] = alpha * sum + beta * C[i * n + j];
+    }
+  }
+}
+
+// Best time of N_ITERS runs of f, each on a fresh copy of C
+template <class F>
+static double bestTime(F f, double *C, const double *C0, long count) {
+  double best = 1e30;
+  for (int i = 0; i < N_ITERS; i++) {
+    memcpy(C, C0, count * sizeof(double));
+    double startTime = CycleTimer::currentSeconds();
+    f();
+    best = std::min(best, CycleTimer::currentSeconds() - startTime);
+  }
+  return best;
+}
+
+static double maxError(const double *C, const double *ref, long count) {
+  double err = 0.0;
+  for (long i = 0; i < count; i++) err = std::max(err, fabs(C[i] - ref[i]));
+  return err;
+}
+
+void usage(const char *binary_name) {
+  fprintf(stderr, "Usage: %s [-n batch] [-s size]...\n", binary_name);
+  fprintf(stderr,
+          "  Times gemm_strided_batched and gemm_batched on batches of "
+          "square\n  matrices against a loop of gemm calls.\n");
+  fprintf(stderr,
+          "  -n INT  matrices per batch (default: %ld MB of operands)\n",
+          DEFAULT_BATCH_BYTES >> 20);
+  fprintf(stderr, "  -s INT  only this size (may be repeated)\n");
+}
+
+int main(int argc, char *argv[]) {
+  long fixedBatch = 0;
+  std::vector<int> only;
+  int opt;
+  while ((opt = getopt(argc, argv, "n:s:h")) != EOF) {
+    switch (opt) {
+      case 'n':
+        fixedBatch = atol(optarg);
+        break;
+      case 's':
+        only.push_back(atoi(optarg));
+        break;
+      case 'h':
+      default:
+        usage(argv[0]);
+        return 1;
+    }
+  }
+  if (only.empty()) only.assign(std::begin(sizes), std::end(sizes));
+
+  const double alpha = 1.0, beta = 1.0;
+  bool correct = true;
+
+  printf("Max threads = %d, best of %d runs\n", omp_get_max_threads(),
+         N_ITERS);
+  printf("%4s %9s | %12s | %12s %8s | %12s %8s | %9s\n", "size", "batch",
+         "gemm Mmat/s", "strided", "GFLOPS", "pointers", "GFLOPS", "max error");
+
+  for (int s : only) {
+    long elems = (long)s * s;
+    long batch = fixedBatch > 0
+                     ? fixedBatch
+                     : std::max(1L, DEFAULT_BATCH_BYTES / (3 * elems * 8));
+    long total = batch * elems;
+
+    double *A = (double *)malloc(total * sizeof(double));
+    double *B = (double *)malloc(total * sizeof(double));
+    double *C = (double *)malloc(total * sizeof(double));
+    double *C0 = (double *)malloc(total * sizeof(double));
+    double *ref = (double *)malloc(total * sizeof(double));
+    if (!A || !B || !C || !C0 || !ref) {
+      fprintf(stderr, "Could not allocate a batch of %ld matrices\n", batch);
+      return 1;
+    }
+    for (long i = 0; i < total; i++) {
+      A[i] = (double)rand() / RAND_MAX;
+      B[i] = (double)rand() / RAND_MAX;
+      C0[i] = (double)rand() / RAND_MAX;
+    }
+    std::vector<const double *> Ap(batch), Bp(batch);
+    std::vector<double *> Cp(batch);
+    for (long b = 0; b < batch; b++) {
+      Ap[b] = A + b * elems;
+      Bp[b] = B + b * elems;
+      Cp[b] = C + b * elems;
+    }
+
+    // Reference results
+    memcpy(ref, C0, total * sizeof(double));
+    for (long b = 0; b < batch; b++)
+      naiveGemm(s, s, s, A + b * elems, B + b * elems, ref + b * elems, alpha,
+                beta);
+
+    double loopTime = bestTime(
+        [&] {
+          for (long b = 0; b < batch; b++)
+            gemm(s, s, s, A + b * elems, B + b * elems, C + b * elems, alpha,
+                 beta);
+        },
+        C, C0, total);
+    double err = maxError(C, ref, total);
+
+    double stridedTime = bestTime(
+        [&] {
+          gemm_strided_batched(s, s, s, alpha, A, elems, B, elems, beta, C,
+                               elems, batch);
+        },
+        C, C0, total);
+    err = std::max(err, maxError(C, ref, total));
+
+    double pointerTime = bestTime(
+        [&] {
+          gemm_batched(s, s, s, alpha, Ap.data(), Bp.data(), beta, Cp.data(),
+                       batch);
+        },
+        C, C0, total);
+    err = std::max(err, maxError(C, ref, total));
+
+    double flops = 2.0 * s * s * s * batch;
+    printf("%4d %9ld | %12.2f | %12.2f %8.2f | %12.2f %8.2f | %9.2g\n", s,
+           batch, batch / loopTime / 1e6, batch / stridedTime / 1e6,
+           flops / stridedTime / 1e9, batch / pointerTime / 1e6,
+           flops / pointerTime / 1e9, err);
+    if (!(err < 1e-10)) correct = false;
+
+    free(A);
+    free(B);
+    free(C);
+    free(C0);
+    free(ref);
+  }
+
+  printf("Correctness: \n");
+  if (!correct) printf("Batched GEMM is not correct\n");
+  return 0;
+}
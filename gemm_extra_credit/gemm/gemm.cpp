@@ -10,8 +10,17 @@
 // any input parameters.
 
 #include <assert.h>
+#include <immintrin.h>
 #include <math.h>
+#include <omp.h>
 #include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include <algorithm>
+
+#include "gemm.h"
 
 #define BLOCKSIZE (6)  // 62 * 62(N) * 8(bytes) \approx = 32KBytes
 
@@ -23,7 +32,9 @@ void __gemm_blocking(int m, int n, int k, double *A, double *B, double *C,
 void gemm(int m, int n, int k, double *A, double *B, double *C, double alpha,
           double beta) {
   // __gemm_naive(m, n, k, A, B, C, alpha, beta);
-  __gemm_blocking(m, n, k, A, B, C, alpha, beta);
+  // __gemm_blocking(m, n, k, A, B, C, alpha, beta);
+  dgemm(GEMM_ROW_MAJOR, GEMM_NO_TRANS, GEMM_NO_TRANS, m, n, k, alpha, A, k, B,
+        n, beta, C, n);
 }
 
 __attribute__((always_inline)) size_t __get_idx(int m, int n, int nc) {
@@ -132,10 +143,6 @@ void __gemm_blocking(int m, int n, int k, double *A, double *B, double *C,
   static_assert(BLOCKSIZE % 2 == 0, "BLOCKSIZE % 2 must be 0");
   // printf("running gemm_blocking: (m=%d, n=%d, k=%d)\n", m, n, k);
 
-  assert(m % 4 == 0);
-  assert(n % 4 == 0);
-  assert(k % 4 == 0);
-
   for (i = 0; i < m; ++i) {
     for (j = 0; j < n; ++j) {
       C[i * n + j] *= beta;
@@ -164,3 +171,891 @@ void __gemm_naive(int m, int n, int k, double *A, double *B, double *C,
     }
   }
 }
+
+// ---------------------------------------------------------------------------
+// Packed GEMM, in the style of GotoBLAS/BLIS.
+//
+// Five loops around a micro-kernel:
+//
+//   for jc in steps of NC:          B panel  (KC x NC) lives in L3
+//     for pc in steps of KC:        pack B[pc:pc+KC, jc:jc+NC]
+//       for ic in steps of MC:      pack A[ic:ic+MC, pc:pc+KC] into L2
+//         for jr in steps of NR:    B micro-panel (KC x NR) lives in L1
+//           for ir in steps of MR:  micro-kernel: MR x NR of C in registers
+//
+// Packing copies the operands into the order the micro-kernel reads
+// them, so its loads are contiguous and aligned, and pads the panels
+// with zeros to whole MR/NR tiles.
+//
+// The loops and the packing are templates on a kernel type K, which
+// gives the element types, the register tile MR x NR, and the micro-
+// kernel (see fp_kernel and i8_kernel below).  A kernel that consumes
+// KP consecutive k at once (KP = 4 for int8 dot products) gets its
+// panels in groups of KP columns of A / rows of B, with k padded to a
+// multiple of KP.
+// ---------------------------------------------------------------------------
+
+struct gemm_params {
+  int mc;
+  int kc;
+  int nc;
+};
+
+static long __cache_size(int name, long fallback) {
+  long size = sysconf(name);
+  return size > 0 ? size : fallback;
+}
+
+// Block sizes from the cache sizes, following the analytical model of
+// BLIS: a KC x NR micro-panel of B takes half of L1 (the other half is
+// for the A micro-panels streaming past it and for C), the MC x KC
+// block of A half of L2, and the KC x NC panel of B half of L3.  d is
+// the size of a packed element.
+static gemm_params __default_params(int mr, int nr, long d) {
+  long l1 = __cache_size(_SC_LEVEL1_DCACHE_SIZE, 32 << 10);
+  long l2 = __cache_size(_SC_LEVEL2_CACHE_SIZE, 256 << 10);
+  long l3 = __cache_size(_SC_LEVEL3_CACHE_SIZE, 8 << 20);
+
+  gemm_params p;
+  p.kc = std::clamp(l1 / 2 / (nr * d), 32L, 4096L) / 8 * 8;
+  p.mc = std::clamp(l2 / 2 / (p.kc * d), (long)mr, 4096L) / mr * mr;
+  // Past a few thousand columns a wider panel only costs memory
+  p.nc = std::clamp(l3 / 2 / (p.kc * d), (long)nr, 4096L) / nr * nr;
+  return p;
+}
+
+template <class K>
+static const gemm_params &__gemm_get_params() {
+  static const gemm_params params =
+      __default_params(K::MR, K::NR, sizeof(typename K::pb_t));
+  return params;
+}
+
+static inline int __round_up(int x, int multiple) {
+  return (x + multiple - 1) / multiple * multiple;
+}
+
+static void *__alloc_panel(long bytes) {
+  return aligned_alloc(64, (bytes + 63) / 64 * 64);
+}
+
+// Elements of one packed micro-panel of A (MR x kc) and of B (kc x NR)
+template <class K>
+static inline long __a_panel_size(int kc) {
+  return (long)__round_up(kc, K::KP) * K::MR;
+}
+
+template <class K>
+static inline long __b_panel_size(int kc) {
+  return (long)__round_up(kc, K::KP) * K::NR + K::b_panel_extra;
+}
+
+// Packs the mc x kc block of A (element (i, p) at A[i * rs + p * cs])
+// into micro-panels of MR rows: panel by panel, then KP columns at a
+// time, row by row (for KP = 1, column by column).
+template <class K>
+static void __pack_A(int mc, int kc, const typename K::a_t *A, int rs, int cs,
+                     typename K::pa_t *buf) {
+  constexpr int MR = K::MR, KP = K::KP;
+  for (int ir = 0; ir < mc; ir += MR) {
+    int mr = std::min(MR, mc - ir);
+    for (int p0 = 0; p0 < kc; p0 += KP) {
+      for (int r = 0; r < mr; r++) {
+        const typename K::a_t *row = A + (long)(ir + r) * rs;
+        for (int q = 0; q < KP; q++) {
+          int p = p0 + q;
+          buf[r * KP + q] = p < kc ? K::pack_a(row[(long)p * cs]) : 0;
+        }
+      }
+      for (int r = mr * KP; r < MR * KP; r++) buf[r] = 0;
+      buf += MR * KP;
+    }
+  }
+}
+
+// Packs the kc x nr (nr <= NR) micro-panel of B (element (p, j) at
+// B[p * rs + j * cs]): KP rows at a time, column by column (for KP = 1,
+// row by row).  K::finish_b_panel can then add data of its own after
+// the panel.
+template <class K>
+static void __pack_B(int kc, int nr, const typename K::b_t *B, int rs, int cs,
+                     typename K::pb_t *buf) {
+  constexpr int NR = K::NR, KP = K::KP;
+  typename K::pb_t *panel = buf;
+  for (int p0 = 0; p0 < kc; p0 += KP) {
+    for (int c = 0; c < nr; c++) {
+      const typename K::b_t *col = B + (long)c * cs;
+      for (int q = 0; q < KP; q++) {
+        int p = p0 + q;
+        buf[c * KP + q] = p < kc ? col[(long)p * rs] : 0;
+      }
+    }
+    for (int c = nr * KP; c < NR * KP; c++) buf[c] = 0;
+    buf += NR * KP;
+  }
+  K::finish_b_panel(kc, panel);
+}
+
+// What is done to the final C as the kernels store it: see
+// gemm_epilogue in gemm.h.  The bias is indexed by the column of the
+// row-major C the kernels see, or by its row when the caller's C is
+// column-major (and so transposed here).
+template <class T>
+struct epilogue {
+  const T *bias;
+  bool bias_on_rows;
+  gemm_activation activation;
+  T clamp_lo, clamp_hi;
+};
+
+// The epilogue for one entry (i, j) of the C the kernels see
+template <class T>
+static inline T __epilogue_scalar(const epilogue<T> &e, T x, int i, int j) {
+  if (e.bias) x += e.bias_on_rows ? e.bias[i] : e.bias[j];
+  if (e.activation == GEMM_RELU) x = std::max(x, (T)0);
+  if (e.activation == GEMM_CLAMP)
+    x = std::min(std::max(x, e.clamp_lo), e.clamp_hi);
+  return x;
+}
+
+// ---------------------------------------------------------------------------
+// Micro-kernels.  Each computes
+//
+//   C[0:mr, 0:nr] = alpha * A * B + beta * C
+//
+// for a packed micro-panel A (MR x kc) and B (kc x NR).  The whole
+// MR x NR tile is always computed (the packing pads with zeros), but
+// only its first mr rows and nr columns are stored, so tiles at the
+// edges of C go through the same kernel.  C is not read when beta is 0.
+// With an epilogue (on the last KC block only), the floating point
+// kernels apply it to the tile in registers before the store; (i, j) is
+// the position of the tile in C.
+// ---------------------------------------------------------------------------
+
+#if defined(__AVX2__) && defined(__FMA__)
+
+// 256-bit vectors of T, for the floating point micro-kernel
+template <class T>
+struct simd;
+
+template <>
+struct simd<double> {
+  typedef __m256d v;
+  static constexpr int W = 4;
+  static v zero() { return _mm256_setzero_pd(); }
+  static v set1(double x) { return _mm256_set1_pd(x); }
+  static v load(const double *p) { return _mm256_load_pd(p); }
+  static v loadu(const double *p) { return _mm256_loadu_pd(p); }
+  static void storeu(double *p, v x) { _mm256_storeu_pd(p, x); }
+  static v broadcast(const double *p) { return _mm256_broadcast_sd(p); }
+  static v mul(v a, v b) { return _mm256_mul_pd(a, b); }
+  static v fmadd(v a, v b, v c) { return _mm256_fmadd_pd(a, b, c); }
+  static v add(v a, v b) { return _mm256_add_pd(a, b); }
+  static v max(v a, v b) { return _mm256_max_pd(a, b); }
+  static v min(v a, v b) { return _mm256_min_pd(a, b); }
+  // Lanes 0 .. n - 1 (none for n <= 0, all for n >= W)
+  static __m256i mask(int n) {
+    return _mm256_cmpgt_epi64(_mm256_set1_epi64x(n),
+                              _mm256_setr_epi64x(0, 1, 2, 3));
+  }
+  static v maskload(const double *p, __m256i m) {
+    return _mm256_maskload_pd(p, m);
+  }
+  static void maskstore(double *p, __m256i m, v x) {
+    _mm256_maskstore_pd(p, m, x);
+  }
+};
+
+template <>
+struct simd<float> {
+  typedef __m256 v;
+  static constexpr int W = 8;
+  static v zero() { return _mm256_setzero_ps(); }
+  static v set1(float x) { return _mm256_set1_ps(x); }
+  static v load(const float *p) { return _mm256_load_ps(p); }
+  static v loadu(const float *p) { return _mm256_loadu_ps(p); }
+  static void storeu(float *p, v x) { _mm256_storeu_ps(p, x); }
+  static v broadcast(const float *p) { return _mm256_broadcast_ss(p); }
+  static v mul(v a, v b) { return _mm256_mul_ps(a, b); }
+  static v fmadd(v a, v b, v c) { return _mm256_fmadd_ps(a, b, c); }
+  static v add(v a, v b) { return _mm256_add_ps(a, b); }
+  static v max(v a, v b) { return _mm256_max_ps(a, b); }
+  static v min(v a, v b) { return _mm256_min_ps(a, b); }
+  static __m256i mask(int n) {
+    return _mm256_cmpgt_epi32(_mm256_set1_epi32(n),
+                              _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7));
+  }
+  static v maskload(const float *p, __m256i m) {
+    return _mm256_maskload_ps(p, m);
+  }
+  static void maskstore(float *p, __m256i m, v x) {
+    _mm256_maskstore_ps(p, m, x);
+  }
+};
+
+// The epilogue for the vector of C at (i, j), of which the lanes in
+// mask are in C
+template <class S, class T>
+static inline typename S::v __epilogue_vector(const epilogue<T> &e,
+                                              typename S::v x, int i, int j,
+                                              __m256i mask) {
+  if (e.bias)
+    x = S::add(x, e.bias_on_rows ? S::set1(e.bias[i])
+                                 : S::maskload(e.bias + j, mask));
+  if (e.activation == GEMM_RELU) x = S::max(x, S::zero());
+  if (e.activation == GEMM_CLAMP)
+    x = S::min(S::max(x, S::set1(e.clamp_lo)), S::set1(e.clamp_hi));
+  return x;
+}
+
+// MR rows of NV vectors: MR * NV accumulators, NV registers of B and 1
+// broadcast of A, which must fit in the 16 ymm registers (6 x 2 takes
+// 15, 4 x 3 takes 16)
+template <class T, int MR, int NV>
+static inline void __fp_micro_kernel(int kc, const T *A, const T *B, T *C,
+                                     int ldc, T alpha, T beta, int mr, int nr,
+                                     const epilogue<T> *ep, int i, int j) {
+  typedef simd<T> S;
+  constexpr int W = S::W, NR = NV * W;
+  static_assert(MR * NV + NV + 1 <= 16, "the tile does not fit in registers");
+
+  typename S::v c[MR][NV];
+#pragma GCC unroll 16
+  for (int r = 0; r < MR; r++)
+#pragma GCC unroll 4
+    for (int v = 0; v < NV; v++) c[r][v] = S::zero();
+
+  for (int p = 0; p < kc; p++) {
+    typename S::v b[NV];
+#pragma GCC unroll 4
+    for (int v = 0; v < NV; v++) b[v] = S::load(B + v * W);
+#pragma GCC unroll 16
+    for (int r = 0; r < MR; r++) {
+      typename S::v a = S::broadcast(A + r);
+#pragma GCC unroll 4
+      for (int v = 0; v < NV; v++) c[r][v] = S::fmadd(a, b[v], c[r][v]);
+    }
+    A += MR;
+    B += NR;
+  }
+
+  typename S::v va = S::set1(alpha);
+  typename S::v vb = S::set1(beta);
+  if (mr == MR && nr == NR) {
+    // The epilogue, from locals: the stores to C could otherwise alias
+    // *ep and force a reload after each one
+    const T *bias = ep ? ep->bias : nullptr;
+    bool bias_on_rows = ep && ep->bias_on_rows;
+    gemm_activation act = ep ? ep->activation : GEMM_NO_ACTIVATION;
+    typename S::v lo = S::set1(ep ? ep->clamp_lo : 0);
+    typename S::v hi = S::set1(ep ? ep->clamp_hi : 0);
+    typename S::v bias_col[NV];
+#pragma GCC unroll 4
+    for (int v = 0; v < NV; v++)
+      bias_col[v] = bias && !bias_on_rows ? S::loadu(bias + j + v * W)
+                                          : S::zero();
+#pragma GCC unroll 16
+    for (int r = 0; r < MR; r++) {
+      T *row = C + (long)r * ldc;
+      typename S::v bias_row =
+          bias && bias_on_rows ? S::set1(bias[i + r]) : S::zero();
+#pragma GCC unroll 4
+      for (int v = 0; v < NV; v++) {
+        typename S::v x = S::mul(va, c[r][v]);
+        if (beta != 0) x = S::fmadd(vb, S::loadu(row + v * W), x);
+        if (bias) x = S::add(x, S::add(bias_row, bias_col[v]));
+        if (act == GEMM_RELU) x = S::max(x, S::zero());
+        if (act == GEMM_CLAMP) x = S::min(S::max(x, lo), hi);
+        S::storeu(row + v * W, x);
+      }
+    }
+    return;
+  }
+
+  // Edge tile: masked loads and stores for the columns
+  __m256i mask[NV];
+#pragma GCC unroll 4
+  for (int v = 0; v < NV; v++) mask[v] = S::mask(nr - v * W);
+  for (int r = 0; r < mr; r++) {
+    T *row = C + (long)r * ldc;
+#pragma GCC unroll 4
+    for (int v = 0; v < NV; v++) {
+      typename S::v x = S::mul(va, c[r][v]);
+      if (beta != 0) x = S::fmadd(vb, S::maskload(row + v * W, mask[v]), x);
+      if (ep) x = __epilogue_vector<S>(*ep, x, i + r, j + v * W, mask[v]);
+      S::maskstore(row + v * W, mask[v], x);
+    }
+  }
+}
+
+#else
+
+template <class T, int MR, int NV>
+static inline void __fp_micro_kernel(int kc, const T *A, const T *B, T *C,
+                                     int ldc, T alpha, T beta, int mr, int nr,
+                                     const epilogue<T> *ep, int i, int j) {
+  constexpr int NR = NV * 32 / sizeof(T);
+  T c[MR][NR] = {};
+  for (int p = 0; p < kc; p++) {
+    for (int r = 0; r < MR; r++)
+      for (int q = 0; q < NR; q++) c[r][q] += A[r] * B[q];
+    A += MR;
+    B += NR;
+  }
+  for (int r = 0; r < mr; r++) {
+    for (int q = 0; q < nr; q++) {
+      T *out = C + (long)r * ldc + q;
+      T x = alpha * c[r][q] + (beta != 0 ? beta * *out : 0);
+      *out = ep ? __epilogue_scalar(*ep, x, i + r, j + q) : x;
+    }
+  }
+}
+
+#endif
+
+// double and float: MR rows of NV 256-bit vectors.  The default 6 x 2
+// vectors is a 6 x 8 tile of doubles or 6 x 16 of floats; dgemm has
+// other shapes for the tuner to pick from (see gemm_tiles).
+template <class T, int MR_ = 6, int NV = 2>
+struct fp_kernel {
+  typedef T a_t, b_t, pa_t, pb_t, c_t, s_t;
+  static constexpr int MR = MR_;
+  static constexpr int NR = NV * 32 / sizeof(T);
+  static constexpr int KP = 1;
+  static constexpr int b_panel_extra = 0;
+
+  static pa_t pack_a(a_t x) { return x; }
+  static void finish_b_panel(int, pb_t *) {}
+  static void micro(int kc, const pa_t *A, const pb_t *B, c_t *C, int ldc,
+                    s_t alpha, s_t beta, int mr, int nr,
+                    const epilogue<c_t> *ep, int i, int j) {
+    __fp_micro_kernel<T, MR, NV>(kc, A, B, C, ldc, alpha, beta, mr, nr, ep, i,
+                                 j);
+  }
+};
+
+// int8 x int8 -> int32.  The dot product instruction (vpdpbusd, of AVX-
+// VNNI or AVX512-VNNI) multiplies unsigned by signed bytes and adds 4
+// products into each 32-bit lane, so:
+//
+//  - A is packed as a + 128, which is unsigned, and the 128 * sum_p B[p][j]
+//    this adds to C[i][j] is subtracted again before the store.  The
+//    column sums of every B micro-panel are computed while packing it
+//    and kept after it (b_panel_extra).
+//  - The panels are packed in groups of 4 k (KP): a 32-bit lane of a B
+//    vector holds B[p..p+3][j], and A[i][p..p+3] is broadcast as one
+//    32-bit value.
+//
+// Without VNNI, AVX2 does the same with 16-bit multiplies (vpmaddwd) of
+// the even and odd bytes, which need more registers: MR drops to 4.
+// vpmaddubsw would saturate its 16-bit sums, so it is not used.
+#if defined(__AVXVNNI__) || (defined(__AVX512VNNI__) && defined(__AVX512VL__))
+#define I8_VNNI 1
+#define I8_MR 6
+#else
+#define I8_VNNI 0
+#define I8_MR 4
+#endif
+
+#if defined(__AVX2__)
+
+static inline __m256i __i8_mask(int n) {
+  return _mm256_cmpgt_epi32(_mm256_set1_epi32(n),
+                            _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7));
+}
+
+template <int MR, int NR>
+static inline void __i8_micro_kernel(int kc, const uint8_t *A,
+                                     const int8_t *B, int32_t *C, int ldc,
+                                     int32_t alpha, int32_t beta, int mr,
+                                     int nr) {
+  static_assert(NR == 16, "the micro-kernel is two vectors wide");
+  const int kq = (kc + 3) / 4;
+  // 128 * (column sums of B), after the panel
+  const int32_t *bias = (const int32_t *)(B + (long)kq * 4 * NR);
+
+  __m256i c[MR][2];
+  for (int r = 0; r < MR; r++) c[r][0] = c[r][1] = _mm256_setzero_si256();
+
+#if I8_VNNI
+  for (int q = 0; q < kq; q++) {
+    __m256i b0 = _mm256_load_si256((const __m256i *)B);
+    __m256i b1 = _mm256_load_si256((const __m256i *)(B + 32));
+#pragma GCC unroll 6
+    for (int r = 0; r < MR; r++) {
+      __m256i a = _mm256_set1_epi32(*(const int32_t *)(A + 4 * r));
+#if defined(__AVXVNNI__)
+      c[r][0] = _mm256_dpbusd_avx_epi32(c[r][0], a, b0);
+      c[r][1] = _mm256_dpbusd_avx_epi32(c[r][1], a, b1);
+#else
+      c[r][0] = _mm256_dpbusd_epi32(c[r][0], a, b0);
+      c[r][1] = _mm256_dpbusd_epi32(c[r][1], a, b1);
+#endif
+    }
+    A += 4 * MR;
+    B += 4 * NR;
+  }
+#else
+  // The even and odd bytes of every 16-bit lane, widened: unsigned for
+  // A, sign-extended for B.  vpmaddwd of the even and of the odd halves
+  // adds up the 4 products of each 32-bit lane.
+  const __m256i low_bytes = _mm256_set1_epi16(0x00ff);
+  for (int q = 0; q < kq; q++) {
+    __m256i b0 = _mm256_load_si256((const __m256i *)B);
+    __m256i b1 = _mm256_load_si256((const __m256i *)(B + 32));
+    __m256i b0e = _mm256_srai_epi16(_mm256_slli_epi16(b0, 8), 8);
+    __m256i b0o = _mm256_srai_epi16(b0, 8);
+    __m256i b1e = _mm256_srai_epi16(_mm256_slli_epi16(b1, 8), 8);
+    __m256i b1o = _mm256_srai_epi16(b1, 8);
+#pragma GCC unroll 4
+    for (int r = 0; r < MR; r++) {
+      __m256i a = _mm256_set1_epi32(*(const int32_t *)(A + 4 * r));
+      __m256i ae = _mm256_and_si256(a, low_bytes);
+      __m256i ao = _mm256_srli_epi16(a, 8);
+      c[r][0] = _mm256_add_epi32(
+          c[r][0], _mm256_add_epi32(_mm256_madd_epi16(ae, b0e),
+                                    _mm256_madd_epi16(ao, b0o)));
+      c[r][1] = _mm256_add_epi32(
+          c[r][1], _mm256_add_epi32(_mm256_madd_epi16(ae, b1e),
+                                    _mm256_madd_epi16(ao, b1o)));
+    }
+    A += 4 * MR;
+    B += 4 * NR;
+  }
+#endif
+
+  const __m256i bias0 = _mm256_load_si256((const __m256i *)bias);
+  const __m256i bias1 = _mm256_load_si256((const __m256i *)(bias + 8));
+  const __m256i va = _mm256_set1_epi32(alpha);
+  const __m256i vb = _mm256_set1_epi32(beta);
+  const __m256i mask_lo = __i8_mask(nr);
+  const __m256i mask_hi = __i8_mask(nr - 8);
+  for (int r = 0; r < mr; r++) {
+    int *row = C + (long)r * ldc;
+    __m256i lo = _mm256_sub_epi32(c[r][0], bias0);
+    __m256i hi = _mm256_sub_epi32(c[r][1], bias1);
+    if (alpha != 1) {
+      lo = _mm256_mullo_epi32(va, lo);
+      hi = _mm256_mullo_epi32(va, hi);
+    }
+    if (beta != 0) {
+      lo = _mm256_add_epi32(
+          lo, _mm256_mullo_epi32(vb, _mm256_maskload_epi32(row, mask_lo)));
+      hi = _mm256_add_epi32(
+          hi, _mm256_mullo_epi32(vb, _mm256_maskload_epi32(row + 8, mask_hi)));
+    }
+    _mm256_maskstore_epi32(row, mask_lo, lo);
+    _mm256_maskstore_epi32(row + 8, mask_hi, hi);
+  }
+}
+
+#else
+
+template <int MR, int NR>
+static inline void __i8_micro_kernel(int kc, const uint8_t *A,
+                                     const int8_t *B, int32_t *C, int ldc,
+                                     int32_t alpha, int32_t beta, int mr,
+                                     int nr) {
+  const int kq = (kc + 3) / 4;
+  const int32_t *bias = (const int32_t *)(B + (long)kq * 4 * NR);
+  int32_t c[MR][NR] = {};
+  for (int q = 0; q < kq; q++) {
+    for (int r = 0; r < MR; r++)
+      for (int j = 0; j < NR; j++)
+        for (int x = 0; x < 4; x++) c[r][j] += A[4 * r + x] * B[4 * j + x];
+    A += 4 * MR;
+    B += 4 * NR;
+  }
+  for (int r = 0; r < mr; r++)
+    for (int j = 0; j < nr; j++)
+      C[(long)r * ldc + j] = alpha * (c[r][j] - bias[j]) +
+                             (beta != 0 ? beta * C[(long)r * ldc + j] : 0);
+}
+
+#endif
+
+struct i8_kernel {
+  typedef int8_t a_t, b_t, pb_t;
+  typedef uint8_t pa_t;
+  typedef int32_t c_t, s_t;
+  static constexpr int MR = I8_MR;
+  static constexpr int NR = 16;
+  static constexpr int KP = 4;
+  static constexpr int b_panel_extra = NR * sizeof(int32_t);
+
+  static pa_t pack_a(a_t x) { return (pa_t)(x + 128); }
+
+  // 128 * the column sums of the panel, after it
+  static void finish_b_panel(int kc, pb_t *panel) {
+    int kq = (kc + KP - 1) / KP;
+    int32_t *bias = (int32_t *)(panel + (long)kq * KP * NR);
+    for (int j = 0; j < NR; j++) bias[j] = 0;
+    for (int q = 0; q < kq; q++)
+      for (int j = 0; j < NR; j++)
+        for (int x = 0; x < KP; x++) bias[j] += panel[(q * NR + j) * KP + x];
+    for (int j = 0; j < NR; j++) bias[j] *= 128;
+  }
+
+  // igemm has no epilogue
+  static void micro(int kc, const pa_t *A, const pb_t *B, c_t *C, int ldc,
+                    s_t alpha, s_t beta, int mr, int nr, const epilogue<c_t> *,
+                    int, int) {
+    __i8_micro_kernel<MR, NR>(kc, A, B, C, ldc, alpha, beta, mr, nr);
+  }
+};
+
+// C[0:mc, 0:nc] = alpha * Ap * Bp + beta * C for a packed block of A
+// and panel of B, at (i, j) in C
+template <class K>
+static void __gemm_macro_kernel(int mc, int nc, int kc,
+                                const typename K::pa_t *Ap,
+                                const typename K::pb_t *Bp, typename K::c_t *C,
+                                int ldc, typename K::s_t alpha,
+                                typename K::s_t beta,
+                                const epilogue<typename K::c_t> *ep, int i,
+                                int j) {
+  const long a_size = __a_panel_size<K>(kc);
+  const long b_size = __b_panel_size<K>(kc);
+  for (int jr = 0; jr < nc; jr += K::NR) {
+    int nr = std::min(K::NR, nc - jr);
+    for (int ir = 0; ir < mc; ir += K::MR) {
+      int mr = std::min(K::MR, mc - ir);
+      K::micro(kc, Ap + ir / K::MR * a_size, Bp + jr / K::NR * b_size,
+               C + (long)ir * ldc + jr, ldc, alpha, beta, mr, nr, ep, i + ir,
+               j + jr);
+    }
+  }
+}
+
+// Size of the blocks when splitting total into pieces of at most
+// max_size: as even as possible, in multiples of multiple, so that
+// a k of 513 with kc = 384 becomes 257 + 256 instead of 384 + 129
+static int __balanced_block(int total, int max_size, int multiple) {
+  int blocks = (total + max_size - 1) / max_size;
+  return std::min(max_size, __round_up((total + blocks - 1) / blocks, multiple));
+}
+
+// Threads are arranged in an ic_ways x jc_ways grid over C: thread
+// (ti, tj) computes one range of rows of C for one range of columns of
+// every B panel.  Of the grids that keep every thread busy, the one
+// with the squarest share of C is picked, since each thread packs the
+// rows of A it needs (m / ic_ways of them) and reads the columns of B
+// it needs (nc / jc_ways of them) for each KC step.
+static void __gemm_thread_grid(int num_threads, int m, int nc, int mr, int nr,
+                               int *ic_ways, int *jc_ways) {
+  int m_tiles = (m + mr - 1) / mr;
+  int n_tiles = (nc + nr - 1) / nr;
+  double best = -1.0;
+  *ic_ways = num_threads;
+  *jc_ways = 1;
+  for (int i = 1; i <= num_threads; i++) {
+    if (num_threads % i != 0) continue;
+    int j = num_threads / i;
+    if (i > m_tiles || j > n_tiles) continue;
+    double perimeter = (double)m / i + (double)nc / j;
+    if (best < 0 || perimeter < best) {
+      best = perimeter;
+      *ic_ways = i;
+      *jc_ways = j;
+    }
+  }
+}
+
+// Start of part `part` of `parts` of the range 0 .. total, in whole
+// multiples of `multiple`
+static inline int __part_start(int total, int parts, int part, int multiple) {
+  int units = (total + multiple - 1) / multiple;
+  return std::min(total, (int)((long)units * part / parts) * multiple);
+}
+
+// Multiply-adds below which another thread costs more than it saves
+#define GEMM_WORK_PER_THREAD (64L * 64 * 64)
+
+// C = alpha * A x B + beta * C for a row-major C with rows ldc apart.
+// Element (i, p) of A is at A[i * rsa + p * csa] and element (p, j) of
+// B at B[p * rsb + j * csb], which covers the transposes.
+//
+// All threads stay in one parallel region for the whole product.  For
+// every KC x NC panel of B they pack it together, one NR micro-panel
+// each at a time, and then share it: each thread multiplies its rows
+// of A, packed into its own buffer, with its columns of the panel.
+//
+// The epilogue, if any, goes with the last KC block, when the tiles of
+// C hold the final sums.
+template <class K>
+static void __gemm_packed(int m, int n, int k, typename K::s_t alpha,
+                          const typename K::a_t *A, int rsa, int csa,
+                          const typename K::b_t *B, int rsb, int csb,
+                          typename K::s_t beta, typename K::c_t *C, int ldc,
+                          const gemm_params &params,
+                          const epilogue<typename K::c_t> *ep = nullptr) {
+  typedef typename K::pa_t pa_t;
+  typedef typename K::pb_t pb_t;
+  constexpr int MR = K::MR, NR = K::NR;
+
+  if (m == 0 || n == 0) return;
+
+  // Nothing to multiply: only the scaling of C is left
+  if (k == 0 || alpha == 0) {
+    for (int i = 0; i < m; i++) {
+      typename K::c_t *row = C + (long)i * ldc;
+      for (int j = 0; j < n; j++) {
+        typename K::c_t x = beta != 0 ? beta * row[j] : 0;
+        row[j] = ep ? __epilogue_scalar(*ep, x, i, j) : x;
+      }
+    }
+    return;
+  }
+
+  int kc_max = __balanced_block(k, params.kc, K::KP);
+  int nc_max = __balanced_block(n, params.nc, NR);
+  const long b_size = __b_panel_size<K>(kc_max);
+  pb_t *Bp = (pb_t *)__alloc_panel((nc_max / NR) * b_size * sizeof(pb_t));
+
+  long work = (long)m * n * k;
+  int num_threads = (int)std::min<long>(omp_get_max_threads(),
+                                        work / GEMM_WORK_PER_THREAD + 1);
+
+#pragma omp parallel num_threads(num_threads)
+  {
+    int nt = omp_get_num_threads();
+    int tid = omp_get_thread_num();
+    int ic_ways, jc_ways;
+    __gemm_thread_grid(nt, m, std::min(n, nc_max), MR, NR, &ic_ways,
+                       &jc_ways);
+    int ti = tid / jc_ways, tj = tid % jc_ways;
+
+    // This thread's rows of C, and its A buffer, allocated by the thread
+    // itself so that its pages are local to it
+    int i_begin = __part_start(m, ic_ways, ti, MR);
+    int i_end = __part_start(m, ic_ways, ti + 1, MR);
+    int mc_max = __balanced_block(std::max(i_end - i_begin, 1), params.mc, MR);
+    pa_t *Ap = (pa_t *)__alloc_panel((mc_max / MR) * __a_panel_size<K>(kc_max) *
+                                     sizeof(pa_t));
+
+    for (int jc = 0; jc < n; jc += nc_max) {
+      int nc = std::min(nc_max, n - jc);
+      int j_begin = __part_start(nc, jc_ways, tj, NR);
+      int j_end = __part_start(nc, jc_ways, tj + 1, NR);
+
+      for (int pc = 0; pc < k; pc += kc_max) {
+        int kc = std::min(kc_max, k - pc);
+        long kc_size = __b_panel_size<K>(kc);
+        // C is scaled by beta with the first product added to it only
+        typename K::s_t beta_pc = pc == 0 ? beta : 1;
+        const epilogue<typename K::c_t> *ep_pc = pc + kc == k ? ep : nullptr;
+
+        // The previous panel must be done with before it is overwritten
+#pragma omp barrier
+#pragma omp for schedule(static)
+        for (int jr = 0; jr < nc; jr += NR) {
+          __pack_B<K>(kc, std::min(NR, nc - jr),
+                      B + (long)pc * rsb + (long)(jc + jr) * csb, rsb, csb,
+                      Bp + jr / NR * kc_size);
+        }
+
+        for (int ic = i_begin; ic < i_end; ic += mc_max) {
+          int mc = std::min(mc_max, i_end - ic);
+          __pack_A<K>(mc, kc, A + (long)ic * rsa + (long)pc * csa, rsa, csa,
+                      Ap);
+          __gemm_macro_kernel<K>(mc, j_end - j_begin, kc, Ap,
+                                 Bp + j_begin / NR * kc_size,
+                                 C + (long)ic * ldc + jc + j_begin, ldc, alpha,
+                                 beta_pc, ep_pc, ic, jc + j_begin);
+        }
+      }
+    }
+
+    free(Ap);
+  }
+
+  free(Bp);
+}
+
+// The BLAS-style entry points: strides of op(A) and op(B) from the
+// layout and transposes
+template <class K>
+static void __gemm_blas(gemm_layout layout, gemm_transpose transA,
+                        gemm_transpose transB, int m, int n, int k,
+                        typename K::s_t alpha, const typename K::a_t *A,
+                        int lda, const typename K::b_t *B, int ldb,
+                        typename K::s_t beta, typename K::c_t *C, int ldc,
+                        const gemm_params &params = __gemm_get_params<K>(),
+                        epilogue<typename K::c_t> *ep = nullptr) {
+  // Row and column strides of op(A) and op(B) in row-major terms: the
+  // element (i, p) of op(A) is at A[i * rsa + p * csa]
+  bool row_major = layout == GEMM_ROW_MAJOR;
+  bool a_rows = row_major == (transA == GEMM_NO_TRANS);
+  bool b_rows = row_major == (transB == GEMM_NO_TRANS);
+  int rsa = a_rows ? lda : 1, csa = a_rows ? 1 : lda;
+  int rsb = b_rows ? ldb : 1, csb = b_rows ? 1 : ldb;
+
+  if (row_major) {
+    __gemm_packed<K>(m, n, k, alpha, A, rsa, csa, B, rsb, csb, beta, C, ldc,
+                     params, ep);
+  } else {
+    // A column-major C is its row-major transpose, and
+    // C^T = op(B)^T x op(A)^T: swap the operands and their strides
+    if (ep) ep->bias_on_rows = !ep->bias_on_rows;
+    __gemm_packed<K>(n, m, k, alpha, B, csb, rsb, A, csa, rsa, beta, C, ldc,
+                     params, ep);
+  }
+}
+
+// ---------------------------------------------------------------------------
+// Tuning of dgemm.  The register tile and the cache blocks that run
+// fastest depend on the machine more than the analytical model above
+// captures, so dgemm takes them from a configuration that the tuner
+// (tune_main.cpp) measures and saves to a file, and that the first call
+// to dgemm loads again.  The file records the cache sizes it was tuned
+// on, and is ignored on a machine with other caches.
+// ---------------------------------------------------------------------------
+
+// Tiles dgemm has a micro-kernel for, as MR x NR, and the kernels: MR
+// rows of NR / 4 vectors
+const int gemm_tiles[GEMM_NUM_TILES][2] = {{6, 8}, {4, 8}, {4, 12}, {12, 4}};
+
+typedef void (*dgemm_kernel_fn)(gemm_layout, gemm_transpose, gemm_transpose,
+                                int, int, int, double, const double *, int,
+                                const double *, int, double, double *, int,
+                                const gemm_params &, epilogue<double> *);
+
+static const dgemm_kernel_fn __dgemm_kernels[GEMM_NUM_TILES] = {
+    __gemm_blas<fp_kernel<double, 6, 2>>, __gemm_blas<fp_kernel<double, 4, 2>>,
+    __gemm_blas<fp_kernel<double, 4, 3>>, __gemm_blas<fp_kernel<double, 12, 1>>};
+
+// Index of the tile in gemm_tiles, or -1
+static int __tile_index(int mr, int nr) {
+  for (int t = 0; t < GEMM_NUM_TILES; t++)
+    if (mr == gemm_tiles[t][0] && nr == gemm_tiles[t][1]) return t;
+  return -1;
+}
+
+#define GEMM_TUNE_FILE_DEFAULT "gemm_tune.cfg"
+
+const char *gemm_config_path() {
+  const char *path = getenv("GEMM_TUNE_FILE");
+  return path && *path ? path : GEMM_TUNE_FILE_DEFAULT;
+}
+
+static void __cache_sizes(long sizes[3]) {
+  sizes[0] = __cache_size(_SC_LEVEL1_DCACHE_SIZE, 0);
+  sizes[1] = __cache_size(_SC_LEVEL2_CACHE_SIZE, 0);
+  sizes[2] = __cache_size(_SC_LEVEL3_CACHE_SIZE, 0);
+}
+
+static bool __valid_config(const gemm_config &c) {
+  return __tile_index(c.mr, c.nr) >= 0 && c.mc >= c.mr && c.mc % c.mr == 0 && c.kc >= 1 &&
+         c.nc >= c.nr && c.nc % c.nr == 0;
+}
+
+gemm_config gemm_default_config(int mr, int nr) {
+  gemm_params p = __default_params(mr, nr, sizeof(double));
+  return {mr, nr, p.mc, p.kc, p.nc};
+}
+
+// The tuning file's configuration, if there is one for this machine
+static bool __load_config(gemm_config *config) {
+  FILE *f = fopen(gemm_config_path(), "r");
+  if (!f) return false;
+  long tuned[3], sizes[3];
+  gemm_config c;
+  char line[256];
+  bool have_caches = false, have_config = false;
+  while (fgets(line, sizeof(line), f)) {
+    if (sscanf(line, "caches %ld %ld %ld", &tuned[0], &tuned[1], &tuned[2]) ==
+        3)
+      have_caches = true;
+    else if (sscanf(line, "dgemm %d %d %d %d %d", &c.mr, &c.nr, &c.mc, &c.kc,
+                    &c.nc) == 5)
+      have_config = true;
+  }
+  fclose(f);
+
+  __cache_sizes(sizes);
+  if (!have_caches || !have_config || !__valid_config(c)) return false;
+  if (tuned[0] != sizes[0] || tuned[1] != sizes[1] || tuned[2] != sizes[2])
+    return false;
+  *config = c;
+  return true;
+}
+
+static gemm_config &__dgemm_config() {
+  static gemm_config config = [] {
+    gemm_config c;
+    if (!__load_config(&c))
+      c = gemm_default_config(fp_kernel<double>::MR, fp_kernel<double>::NR);
+    return c;
+  }();
+  return config;
+}
+
+gemm_config gemm_get_config() { return __dgemm_config(); }
+
+bool gemm_set_config(const gemm_config &config) {
+  if (!__valid_config(config)) return false;
+  __dgemm_config() = config;
+  return true;
+}
+
+bool gemm_save_config(const gemm_config &config) {
+  if (!__valid_config(config)) return false;
+  FILE *f = fopen(gemm_config_path(), "w");
+  if (!f) return false;
+  long sizes[3];
+  __cache_sizes(sizes);
+  fprintf(f, "# dgemm tuning: the caches it was tuned on (L1d, L2, L3 bytes)\n");
+  fprintf(f, "# and the register tile and blocks: mr nr mc kc nc\n");
+  fprintf(f, "caches %ld %ld %ld\n", sizes[0], sizes[1], sizes[2]);
+  fprintf(f, "dgemm %d %d %d %d %d\n", config.mr, config.nr, config.mc,
+          config.kc, config.nc);
+  return fclose(f) == 0;
+}
+
+// dgemm with the configured tile and blocks
+static void __dgemm(gemm_layout layout, gemm_transpose transA,
+                    gemm_transpose transB, int m, int n, int k, double alpha,
+                    const double *A, int lda, const double *B, int ldb,
+                    double beta, double *C, int ldc, epilogue<double> *ep) {
+  const gemm_config &c = __dgemm_config();
+  __dgemm_kernels[__tile_index(c.mr, c.nr)](layout, transA, transB, m, n, k,
+                                            alpha, A, lda, B, ldb, beta, C,
+                                            ldc, {c.mc, c.kc, c.nc}, ep);
+}
+
+void dgemm(gemm_layout layout, gemm_transpose transA, gemm_transpose transB,
+           int m, int n, int k, double alpha, const double *A, int lda,
+           const double *B, int ldb, double beta, double *C, int ldc) {
+  __dgemm(layout, transA, transB, m, n, k, alpha, A, lda, B, ldb, beta, C, ldc,
+          nullptr);
+}
+
+void dgemm_fused(gemm_layout layout, gemm_transpose transA,
+                 gemm_transpose transB, int m, int n, int k, double alpha,
+                 const double *A, int lda, const double *B, int ldb,
+                 double beta, double *C, int ldc,
+                 const gemm_epilogue *epilogue_ops) {
+  if (!epilogue_ops) {
+    dgemm(layout, transA, transB, m, n, k, alpha, A, lda, B, ldb, beta, C,
+          ldc);
+    return;
+  }
+  const gemm_epilogue &e = *epilogue_ops;
+  epilogue<double> ep = {e.bias, false, e.activation, e.clamp_lo, e.clamp_hi};
+  __dgemm(layout, transA, transB, m, n, k, alpha, A, lda, B, ldb, beta, C, ldc,
+          &ep);
+}
+
+void sgemm(gemm_layout layout, gemm_transpose transA, gemm_transpose transB,
+           int m, int n, int k, float alpha, const float *A, int lda,
+           const float *B, int ldb, float beta, float *C, int ldc) {
+  __gemm_blas<fp_kernel<float>>(layout, transA, transB, m, n, k, alpha, A,
+                                lda, B, ldb, beta, C, ldc);
+}
+
+void igemm(gemm_layout layout, gemm_transpose transA, gemm_transpose transB,
+           int m, int n, int k, int32_t alpha, const int8_t *A, int lda,
+           const int8_t *B, int ldb, int32_t beta, int32_t *C, int ldc) {
+  __gemm_blas<i8_kernel>(layout, transA, transB, m, n, k, alpha, A, lda, B,
+                         ldb, beta, C, ldc);
+}
@@ -0,0 +1,118 @@
+#ifndef __GEMM_H__
+#define __GEMM_H__
+
+// gemm -- general double precision dense matrix-matrix multiplication.
+
+#include <stdint.h>
+
+enum gemm_layout { GEMM_ROW_MAJOR, GEMM_COL_MAJOR };
+enum gemm_transpose { GEMM_NO_TRANS, GEMM_TRANS };
+
+// C = alpha * A x B + beta * C, for dense row-major matrices: C is
+// M x N, A is M x K and B is K x N
+void gemm(int m, int n, int k, double *A, double *B, double *C, double alpha,
+          double beta);
+
+// C = alpha * op(A) x op(B) + beta * C, with the arguments of
+// cblas_dgemm.  op(X) is X or its transpose, op(A) is M x K, op(B) is
+// K x N and C is M x N.  lda, ldb and ldc are the distances between
+// consecutive rows (row-major) or columns (column-major) of the
+// matrices as stored, so submatrices of larger buffers can be passed
+// directly.  The transposes are never formed: the operands are read
+// through their strides while they are packed.
+void dgemm(gemm_layout layout, gemm_transpose transA, gemm_transpose transB,
+           int m, int n, int k, double alpha, const double *A, int lda,
+           const double *B, int ldb, double beta, double *C, int ldc);
+
+enum gemm_activation { GEMM_NO_ACTIVATION, GEMM_RELU, GEMM_CLAMP };
+
+// Elementwise operations applied to each entry C(i, j) of the result,
+// in this order: C(i, j) += bias[j] (if bias is not null, N entries);
+// then max(C(i, j), 0) for GEMM_RELU, or C(i, j) clamped to [clamp_lo,
+// clamp_hi] for GEMM_CLAMP.  j is the column of C whatever its layout.
+struct gemm_epilogue {
+  const double *bias;
+  gemm_activation activation;
+  double clamp_lo, clamp_hi;
+};
+
+// dgemm followed by epilogue (which may be null), fused into the
+// stores of each tile of C after its last update instead of another
+// pass over C in memory: the operations are applied to the tile in
+// registers before it is stored.
+void dgemm_fused(gemm_layout layout, gemm_transpose transA,
+                 gemm_transpose transB, int m, int n, int k, double alpha,
+                 const double *A, int lda, const double *B, int ldb,
+                 double beta, double *C, int ldc,
+                 const gemm_epilogue *epilogue);
+
+// Blocking of dgemm: the register tile of its micro-kernel (MR x NR,
+// one of gemm_tiles) and the cache blocks MC, KC and NC (MC a multiple
+// of MR, NC of NR).
+struct gemm_config {
+  int mr, nr;
+  int mc, kc, nc;
+};
+
+#define GEMM_NUM_TILES 4
+extern const int gemm_tiles[GEMM_NUM_TILES][2];
+
+// The configuration dgemm (and so gemm) uses.  The first call loads it
+// from the tuning file written by gemm_save_config, when that file was
+// written on a machine with the same cache sizes, and otherwise derives
+// it from the cache sizes.
+gemm_config gemm_get_config();
+
+// The configuration derived from the cache sizes for an MR x NR tile
+gemm_config gemm_default_config(int mr, int nr);
+
+// Makes dgemm use config from now on (not while another thread is in
+// dgemm).  Returns false, and changes nothing, if config is not valid.
+bool gemm_set_config(const gemm_config &config);
+
+// Writes config, with the cache sizes of this machine, to the tuning
+// file: $GEMM_TUNE_FILE, or gemm_tune.cfg in the working directory.
+// Returns false if the file cannot be written.
+bool gemm_save_config(const gemm_config &config);
+const char *gemm_config_path();
+
+// The same in single precision: twice the elements per vector, so about
+// twice the throughput of dgemm.
+void sgemm(gemm_layout layout, gemm_transpose transA, gemm_transpose transB,
+           int m, int n, int k, float alpha, const float *A, int lda,
+           const float *B, int ldb, float beta, float *C, int ldc);
+
+// The same for 8-bit integer operands and a 32-bit integer C, as in
+// quantized inference.  The products are exact; sums that do not fit
+// in 32 bits wrap around.  Uses the VNNI dot product instructions when
+// the compiler targets them (-march with AVX-VNNI or AVX512-VNNI).
+void igemm(gemm_layout layout, gemm_transpose transA, gemm_transpose transB,
+           int m, int n, int k, int32_t alpha, const int8_t *A, int lda,
+           const int8_t *B, int ldb, int32_t beta, int32_t *C, int ldc);
+
+// C = alpha * A x B + beta * C for dense row-major matrices (rows lda,
+// ldb and ldc apart) with the Strassen-Winograd algorithm: levels of 7
+// half-size products instead of 8, down to where M, N or K is at most
+// cutoff (0 for the default), below which dgemm takes over.  Fewer
+// flops for large matrices, at the cost of a larger rounding error and
+// of about M x K / 4 + K x N / 4 + M x N / 2 doubles of workspace per
+// level, which is kept for later calls from the same thread.
+void gemm_strassen(int m, int n, int k, double alpha, const double *A,
+                   int lda, const double *B, int ldb, double beta, double *C,
+                   int ldc, int cutoff);
+
+// C[i] = alpha * A[i] x B[i] + beta * C[i] for i = 0 .. batch - 1, for
+// a batch of dense row-major products of the same shape (C[i] is M x N,
+// A[i] is M x K and B[i] is K x N).  Meant for many small matrices:
+// common square sizes up to 32 have kernels of their own, and the
+// batch is split across threads.
+void gemm_batched(int m, int n, int k, double alpha, const double *const *A,
+                  const double *const *B, double beta, double *const *C,
+                  long batch);
+
+// The same, with matrix i of each operand at A + i * stride_a, etc.
+void gemm_strided_batched(int m, int n, int k, double alpha, const double *A,
+                          long stride_a, const double *B, long stride_b,
+                          double beta, double *C, long stride_c, long batch);
+
+#endif /* __GEMM_H__ */
@@ -0,0 +1,283 @@
+// Batched GEMM for many small matrices.
+//
+// For a 4x4 or 8x8 product the blocking and packing of dgemm cost far
+// more than the multiply itself, so the batched entry points go
+// straight to kernels with M, N and K known at compile time:
+//
+//  - sizes with N a multiple of 4 keep tiles of C in registers, one
+//    row of ymm registers per row of C, and read A and B in place;
+//  - sizes 3 to 7 would leave part of every register empty, so they
+//    put four matrices of the batch in the four lanes instead and
+//    compute four products at once;
+//  - 2 x 2 x 2 is done with scalar code the compiler fully unrolls,
+//    which beats gathering four matrices into lanes;
+//  - other sizes up to 32 fall back to a plain loop, and larger ones
+//    to dgemm.
+//
+// The batch is split across threads.
+
+#include <immintrin.h>
+#include <omp.h>
+
+#include "gemm.h"
+
+// Multiply-adds below which another thread costs more than it saves
+#define BATCH_WORK_PER_THREAD (64L * 64 * 64)
+
+// Largest size handled without dgemm
+#define BATCH_SMALL_MAX 32
+
+// Where the matrices of a batch are: at fixed strides from the first
+// ones, or anywhere
+struct batch_strided {
+  const double *A;
+  const double *B;
+  double *C;
+  long stride_a, stride_b, stride_c;
+
+  const double *a(long i) const { return A + i * stride_a; }
+  const double *b(long i) const { return B + i * stride_b; }
+  double *c(long i) const { return C + i * stride_c; }
+};
+
+struct batch_pointers {
+  const double *const *A;
+  const double *const *B;
+  double *const *C;
+
+  const double *a(long i) const { return A[i]; }
+  const double *b(long i) const { return B[i]; }
+  double *c(long i) const { return C[i]; }
+};
+
+// Any size, for the shapes without a kernel of their own
+static inline void __small_gemm_loop(int m, int n, int k, const double *A,
+                                     const double *B, double *C, double alpha,
+                                     double beta) {
+  double acc[BATCH_SMALL_MAX];
+  for (int i = 0; i < m; i++) {
+    for (int j = 0; j < n; j++) acc[j] = 0.0;
+    for (int p = 0; p < k; p++) {
+      double a = A[i * k + p];
+      for (int j = 0; j < n; j++) acc[j] += a * B[p * n + j];
+    }
+    for (int j = 0; j < n; j++)
+      C[i * n + j] = alpha * acc[j] + (beta != 0.0 ? beta * C[i * n + j] : 0.0);
+  }
+}
+
+#if defined(__AVX2__) && defined(__FMA__)
+
+// Rows 0 .. R-1 and vector columns 0 .. V-1 (4 doubles each) of C,
+// with A, B and C of the full M x K, K x N and M x N product
+template <int R, int V, int N, int K>
+static inline void __small_tile(const double *A, const double *B, double *C,
+                                double alpha, double beta) {
+  __m256d c[R][V];
+  for (int r = 0; r < R; r++)
+    for (int v = 0; v < V; v++) c[r][v] = _mm256_setzero_pd();
+
+  for (int p = 0; p < K; p++) {
+    __m256d b[V];
+    for (int v = 0; v < V; v++) b[v] = _mm256_loadu_pd(B + p * N + 4 * v);
+    for (int r = 0; r < R; r++) {
+      __m256d a = _mm256_broadcast_sd(A + r * K + p);
+      for (int v = 0; v < V; v++) c[r][v] = _mm256_fmadd_pd(a, b[v], c[r][v]);
+    }
+  }
+
+  __m256d va = _mm256_set1_pd(alpha);
+  __m256d vb = _mm256_set1_pd(beta);
+  for (int r = 0; r < R; r++) {
+    for (int v = 0; v < V; v++) {
+      double *out = C + r * N + 4 * v;
+      __m256d x = _mm256_mul_pd(va, c[r][v]);
+      if (beta != 0.0) x = _mm256_fmadd_pd(vb, _mm256_loadu_pd(out), x);
+      _mm256_storeu_pd(out, x);
+    }
+  }
+}
+
+// C = alpha * A x B + beta * C for one M x N x K product.  When N is a
+// multiple of 4: tiles of up to 2 vectors (8 columns) by 6 rows, or of
+// 1 vector by 12 rows when N is 4, so that the accumulators take at
+// most 12 of the 16 ymm registers.  Otherwise a loop with constant
+// bounds, for the compiler to unroll.
+template <int M, int N, int K>
+static inline void __small_gemm(const double *A, const double *B, double *C,
+                                double alpha, double beta) {
+  if constexpr (N % 4 != 0) {
+    __small_gemm_loop(M, N, K, A, B, C, alpha, beta);
+  } else {
+    constexpr int NV = N / 4;
+    constexpr int V = NV >= 2 ? 2 : 1;
+    constexpr int R = V == 2 ? 6 : 12;
+
+    for (int v = 0; v + V <= NV; v += V) {
+      int i = 0;
+      for (; i + R <= M; i += R)
+        __small_tile<R, V, N, K>(A + i * K, B + 4 * v, C + i * N + 4 * v,
+                                 alpha, beta);
+      if constexpr (M % R != 0)
+        __small_tile<M % R, V, N, K>(A + i * K, B + 4 * v, C + i * N + 4 * v,
+                                     alpha, beta);
+    }
+    // An odd vector left over: one column of vectors, 12 rows at a time
+    if constexpr (NV % V != 0) {
+      constexpr int v = NV - 1;
+      int i = 0;
+      for (; i + 12 <= M; i += 12)
+        __small_tile<12, 1, N, K>(A + i * K, B + 4 * v, C + i * N + 4 * v,
+                                  alpha, beta);
+      if constexpr (M % 12 != 0)
+        __small_tile<M % 12, 1, N, K>(A + i * K, B + 4 * v,
+                                      C + i * N + 4 * v, alpha, beta);
+    }
+  }
+}
+
+// Four products at once, one per lane: A[l], B[l] and C[l] are the
+// matrices of lane l.  Up to 3 x 3 the accumulators stay in registers;
+// past that some spill, but to L1 and still a lane per matrix.
+template <int M, int N, int K>
+static inline void __small_gemm_x4(const double *const A[4],
+                                   const double *const B[4],
+                                   double *const C[4], double alpha,
+                                   double beta) {
+  __m256d c[M][N];
+  for (int i = 0; i < M; i++)
+    for (int j = 0; j < N; j++) c[i][j] = _mm256_setzero_pd();
+
+  for (int p = 0; p < K; p++) {
+    __m256d b[N];
+    for (int j = 0; j < N; j++) {
+      int x = p * N + j;
+      b[j] = _mm256_setr_pd(B[0][x], B[1][x], B[2][x], B[3][x]);
+    }
+    for (int i = 0; i < M; i++) {
+      int x = i * K + p;
+      __m256d a = _mm256_setr_pd(A[0][x], A[1][x], A[2][x], A[3][x]);
+      for (int j = 0; j < N; j++) c[i][j] = _mm256_fmadd_pd(a, b[j], c[i][j]);
+    }
+  }
+
+  __m256d va = _mm256_set1_pd(alpha);
+  __m256d vb = _mm256_set1_pd(beta);
+  for (int i = 0; i < M; i++) {
+    for (int j = 0; j < N; j++) {
+      int x = i * N + j;
+      __m256d out = _mm256_mul_pd(va, c[i][j]);
+      if (beta != 0.0)
+        out = _mm256_fmadd_pd(
+            vb, _mm256_setr_pd(C[0][x], C[1][x], C[2][x], C[3][x]), out);
+      alignas(32) double lanes[4];
+      _mm256_store_pd(lanes, out);
+      for (int l = 0; l < 4; l++) C[l][x] = lanes[l];
+    }
+  }
+}
+
+#else
+
+template <int M, int N, int K>
+static inline void __small_gemm(const double *A, const double *B, double *C,
+                                double alpha, double beta) {
+  __small_gemm_loop(M, N, K, A, B, C, alpha, beta);
+}
+
+template <int M, int N, int K>
+static inline void __small_gemm_x4(const double *const A[4],
+                                   const double *const B[4],
+                                   double *const C[4], double alpha,
+                                   double beta) {
+  for (int l = 0; l < 4; l++)
+    __small_gemm_loop(M, N, K, A[l], B[l], C[l], alpha, beta);
+}
+
+#endif
+
+template <int M, int N, int K, class Batch>
+static void __batch_small(const Batch &batch, long count, double alpha,
+                          double beta) {
+  bool parallel = count * M * N * K >= 2 * BATCH_WORK_PER_THREAD;
+#pragma omp parallel for schedule(static) if (parallel)
+  for (long i = 0; i < count; i++)
+    __small_gemm<M, N, K>(batch.a(i), batch.b(i), batch.c(i), alpha, beta);
+}
+
+template <int M, int N, int K, class Batch>
+static void __batch_lanes(const Batch &batch, long count, double alpha,
+                          double beta) {
+  long groups = count / 4;
+  bool parallel = count * M * N * K >= 2 * BATCH_WORK_PER_THREAD;
+#pragma omp parallel for schedule(static) if (parallel)
+  for (long g = 0; g < groups; g++) {
+    long i = 4 * g;
+    const double *A[4] = {batch.a(i), batch.a(i + 1), batch.a(i + 2),
+                          batch.a(i + 3)};
+    const double *B[4] = {batch.b(i), batch.b(i + 1), batch.b(i + 2),
+                          batch.b(i + 3)};
+    double *C[4] = {batch.c(i), batch.c(i + 1), batch.c(i + 2),
+                    batch.c(i + 3)};
+    __small_gemm_x4<M, N, K>(A, B, C, alpha, beta);
+  }
+  for (long i = 4 * groups; i < count; i++)
+    __small_gemm_loop(M, N, K, batch.a(i), batch.b(i), batch.c(i), alpha,
+                      beta);
+}
+
+template <class Batch>
+static void __batch_generic(int m, int n, int k, const Batch &batch,
+                            long count, double alpha, double beta) {
+  long work = (long)m * n * k;
+  if (m > BATCH_SMALL_MAX || n > BATCH_SMALL_MAX || k > BATCH_SMALL_MAX) {
+    // Big enough for the blocking to pay: dgemm per matrix, which is
+    // threaded itself
+    for (long i = 0; i < count; i++)
+      dgemm(GEMM_ROW_MAJOR, GEMM_NO_TRANS, GEMM_NO_TRANS, m, n, k, alpha,
+            batch.a(i), k, batch.b(i), n, beta, batch.c(i), n);
+    return;
+  }
+  bool parallel = count * work >= 2 * BATCH_WORK_PER_THREAD;
+#pragma omp parallel for schedule(static) if (parallel)
+  for (long i = 0; i < count; i++)
+    __small_gemm_loop(m, n, k, batch.a(i), batch.b(i), batch.c(i), alpha,
+                      beta);
+}
+
+// Square sizes with kernels of their own
+template <class Batch>
+static void __gemm_batched(int m, int n, int k, const Batch &batch,
+                           long count, double alpha, double beta) {
+  if (count <= 0 || m <= 0 || n <= 0) return;
+  if (m == n && n == k) {
+    switch (m) {
+      case 2: return __batch_small<2, 2, 2>(batch, count, alpha, beta);
+      case 3: return __batch_lanes<3, 3, 3>(batch, count, alpha, beta);
+      case 5: return __batch_lanes<5, 5, 5>(batch, count, alpha, beta);
+      case 6: return __batch_lanes<6, 6, 6>(batch, count, alpha, beta);
+      case 7: return __batch_lanes<7, 7, 7>(batch, count, alpha, beta);
+      case 4: return __batch_small<4, 4, 4>(batch, count, alpha, beta);
+      case 8: return __batch_small<8, 8, 8>(batch, count, alpha, beta);
+      case 12: return __batch_small<12, 12, 12>(batch, count, alpha, beta);
+      case 16: return __batch_small<16, 16, 16>(batch, count, alpha, beta);
+      case 24: return __batch_small<24, 24, 24>(batch, count, alpha, beta);
+      case 32: return __batch_small<32, 32, 32>(batch, count, alpha, beta);
+    }
+  }
+  __batch_generic(m, n, k, batch, count, alpha, beta);
+}
+
+void gemm_batched(int m, int n, int k, double alpha, const double *const *A,
+                  const double *const *B, double beta, double *const *C,
+                  long batch) {
+  __gemm_batched(m, n, k, batch_pointers{A, B, C}, batch, alpha, beta);
+}
+
+void gemm_strided_batched(int m, int n, int k, double alpha, const double *A,
+                          long stride_a, const double *B, long stride_b,
+                          double beta, double *C, long stride_c, long batch) {
+  __gemm_batched(m, n, k,
+                 batch_strided{A, B, C, stride_a, stride_b, stride_c}, batch,
+                 alpha, beta);
+}
@@ -0,0 +1,229 @@
+// Strassen-Winograd multiplication for large matrices.
+//
+// Each level splits A, B and C into quadrants and forms the product
+// with 7 multiplications of the quadrants instead of 8, at the cost of
+// 15 additions of quadrants (Winograd's variant of Strassen's
+// algorithm).  The multiplications recurse until a dimension is at or
+// below the cutoff, and below that dgemm does the work, so each level
+// saves 1/8 of the flops of the one above it for a few extra passes
+// over quadrants.  The bound on the error grows by a constant factor
+// with every level, which is why the recursion is kept shallow.
+//
+// Odd dimensions are peeled: the recursion handles the even part and
+// dgemm the last row, column or rank-1 update.
+//
+// Each level needs one quadrant of A, one of B and two of C as
+// temporaries.  They come from an arena that is sized for the whole
+// recursion before it starts and kept between calls, so that repeated
+// products of the same size allocate nothing.
+
+#include <omp.h>
+#include <stdlib.h>
+
+#include <algorithm>
+
+#include "gemm.h"
+
+// Below this size one level costs more in additions than it saves in
+// multiplications on any machine we have tried
+#define STRASSEN_MIN_CUTOFF 128
+
+// Cutoff when the caller passes 0: the largest size where one level
+// lost to dgemm in the crossover sweep of `gemm -S` (see report.md)
+#define STRASSEN_DEFAULT_CUTOFF 384
+
+// Doubles of a block of count, rounded up to whole cache lines
+static inline long __pad(long count) { return (count + 7) / 8 * 8; }
+
+// Bump allocator for the temporaries.  Levels release their
+// temporaries in the reverse order of allocation, so a mark to go back
+// to is all the bookkeeping needed.
+struct strassen_arena {
+  double *base = nullptr;
+  long capacity = 0;
+  long used = 0;
+
+  ~strassen_arena() { free(base); }
+
+  void reserve(long count) {
+    if (count <= capacity) return;
+    free(base);
+    capacity = count;
+    base = (double *)aligned_alloc(64, capacity * sizeof(double));
+  }
+
+  // Every block starts on a cache line
+  double *take(long count) {
+    double *p = base + used;
+    used += __pad(count);
+    return p;
+  }
+};
+
+// One arena per thread, so that threads can multiply concurrently
+static thread_local strassen_arena __arena;
+
+static inline bool __strassen_recurse(int m, int n, int k, int cutoff) {
+  return m > cutoff && n > cutoff && k > cutoff;
+}
+
+// Doubles of workspace for an m x n x k product and its recursion
+static long __strassen_workspace(int m, int n, int k, int cutoff) {
+  long total = 0;
+  while (__strassen_recurse(m, n, k, cutoff)) {
+    int m2 = m / 2, n2 = n / 2, k2 = k / 2;
+    total += __pad((long)m2 * k2) + __pad((long)k2 * n2) +
+             2 * __pad((long)m2 * n2);
+    m = m2;
+    n = n2;
+    k = k2;
+  }
+  return total;
+}
+
+// Elementwise passes over m x n matrices with their own leading
+// dimensions.  Z may be the same matrix as X or Y.
+template <class F>
+static void __elementwise(int m, int n, double *Z, int ldz, const double *X,
+                          int ldx, const double *Y, int ldy, F f) {
+  bool parallel = (long)m * n >= 64L * 1024;
+#pragma omp parallel for schedule(static) if (parallel)
+  for (int i = 0; i < m; i++) {
+    double *z = Z + (long)i * ldz;
+    const double *x = X + (long)i * ldx;
+    const double *y = Y + (long)i * ldy;
+    for (int j = 0; j < n; j++) z[j] = f(x[j], y[j]);
+  }
+}
+
+static void __add(int m, int n, const double *X, int ldx, const double *Y,
+                  int ldy, double *Z, int ldz) {
+  __elementwise(m, n, Z, ldz, X, ldx, Y, ldy,
+                [](double x, double y) { return x + y; });
+}
+
+static void __sub(int m, int n, const double *X, int ldx, const double *Y,
+                  int ldy, double *Z, int ldz) {
+  __elementwise(m, n, Z, ldz, X, ldx, Y, ldy,
+                [](double x, double y) { return x - y; });
+}
+
+// C = beta * C + X + Y (Y may be null)
+static void __accumulate(int m, int n, double beta, const double *X, int ldx,
+                         const double *Y, int ldy, double *C, int ldc) {
+  bool parallel = (long)m * n >= 64L * 1024;
+#pragma omp parallel for schedule(static) if (parallel)
+  for (int i = 0; i < m; i++) {
+    double *c = C + (long)i * ldc;
+    const double *x = X + (long)i * ldx;
+    const double *y = Y ? Y + (long)i * ldy : nullptr;
+    for (int j = 0; j < n; j++) {
+      double sum = y ? x[j] + y[j] : x[j];
+      c[j] = beta != 0.0 ? beta * c[j] + sum : sum;
+    }
+  }
+}
+
+static void __strassen(int m, int n, int k, double alpha, const double *A,
+                       int lda, const double *B, int ldb, double beta,
+                       double *C, int ldc, int cutoff);
+
+// One level on even m, n and k
+static void __strassen_level(int m, int n, int k, double alpha,
+                             const double *A, int lda, const double *B,
+                             int ldb, double beta, double *C, int ldc,
+                             int cutoff) {
+  const int m2 = m / 2, n2 = n / 2, k2 = k / 2;
+  const double *A11 = A, *A12 = A + k2;
+  const double *A21 = A + (long)m2 * lda, *A22 = A21 + k2;
+  const double *B11 = B, *B12 = B + n2;
+  const double *B21 = B + (long)k2 * ldb, *B22 = B21 + n2;
+  double *C11 = C, *C12 = C + n2;
+  double *C21 = C + (long)m2 * ldc, *C22 = C21 + n2;
+
+  // S: a quadrant of A, T: a quadrant of B, Q and R: quadrants of C
+  long mark = __arena.used;
+  const int lds = k2, ldt = n2, ldq = n2;
+  double *S = __arena.take((long)m2 * k2);
+  double *T = __arena.take((long)k2 * n2);
+  double *Q = __arena.take((long)m2 * n2);
+  double *R = __arena.take((long)m2 * n2);
+
+  // Winograd's products (all scaled by alpha):
+  //   P1 = A11 B11                P5 = (A21 + A22)(B12 - B11)
+  //   P2 = A12 B21                P6 = (A21 + A22 - A11)(B22 - B12 + B11)
+  //   P3 = (A12 - A21 - A22 + A11) B22
+  //   P4 = A22 (B22 - B12 + B11 - B21)
+  //   P7 = (A11 - A21)(B22 - B12)
+  // and with U2 = P1 + P6 and U3 = U2 + P7:
+  //   C11 = P1 + P2               C12 = U2 + P5 + P3
+  //   C21 = U3 - P4               C22 = U3 + P5
+
+  // Q = P1; C11 = beta C11 + P1 + P2
+  __strassen(m2, n2, k2, alpha, A11, lda, B11, ldb, 0.0, Q, ldq, cutoff);
+  __accumulate(m2, n2, beta, Q, ldq, nullptr, 0, C11, ldc);
+  __strassen(m2, n2, k2, alpha, A12, lda, B21, ldb, 1.0, C11, ldc, cutoff);
+
+  // R = P5
+  __add(m2, k2, A21, lda, A22, lda, S, lds);
+  __sub(k2, n2, B12, ldb, B11, ldb, T, ldt);
+  __strassen(m2, n2, k2, alpha, S, lds, T, ldt, 0.0, R, ldq, cutoff);
+
+  // Q = U2 = P1 + P6; C12 = beta C12 + U2 + P5
+  __sub(m2, k2, S, lds, A11, lda, S, lds);
+  __sub(k2, n2, B22, ldb, T, ldt, T, ldt);
+  __strassen(m2, n2, k2, alpha, S, lds, T, ldt, 1.0, Q, ldq, cutoff);
+  __accumulate(m2, n2, beta, Q, ldq, R, ldq, C12, ldc);
+
+  // C21 = beta C21 - P4, with T = B22 - B12 + B11 - B21 from the T above
+  __sub(k2, n2, T, ldt, B21, ldb, T, ldt);
+  __strassen(m2, n2, k2, -alpha, A22, lda, T, ldt, beta, C21, ldc, cutoff);
+
+  // C12 += P3, with S = A12 - (A21 + A22 - A11) from the S above
+  __sub(m2, k2, A12, lda, S, lds, S, lds);
+  __strassen(m2, n2, k2, alpha, S, lds, B22, ldb, 1.0, C12, ldc, cutoff);
+
+  // Q = U3 = U2 + P7; C21 += U3; C22 = beta C22 + U3 + P5
+  __sub(m2, k2, A11, lda, A21, lda, S, lds);
+  __sub(k2, n2, B22, ldb, B12, ldb, T, ldt);
+  __strassen(m2, n2, k2, alpha, S, lds, T, ldt, 1.0, Q, ldq, cutoff);
+  __accumulate(m2, n2, 1.0, Q, ldq, nullptr, 0, C21, ldc);
+  __accumulate(m2, n2, beta, Q, ldq, R, ldq, C22, ldc);
+
+  __arena.used = mark;
+}
+
+static void __strassen(int m, int n, int k, double alpha, const double *A,
+                       int lda, const double *B, int ldb, double beta,
+                       double *C, int ldc, int cutoff) {
+  if (!__strassen_recurse(m, n, k, cutoff)) {
+    dgemm(GEMM_ROW_MAJOR, GEMM_NO_TRANS, GEMM_NO_TRANS, m, n, k, alpha, A, lda,
+          B, ldb, beta, C, ldc);
+    return;
+  }
+
+  // The even part recursively, and what an odd m, n or k leaves over
+  // with dgemm
+  const int me = m & ~1, ne = n & ~1, ke = k & ~1;
+  __strassen_level(me, ne, ke, alpha, A, lda, B, ldb, beta, C, ldc, cutoff);
+  if (ke < k)
+    dgemm(GEMM_ROW_MAJOR, GEMM_NO_TRANS, GEMM_NO_TRANS, me, ne, 1, alpha,
+          A + ke, lda, B + (long)ke * ldb, ldb, 1.0, C, ldc);
+  if (ne < n)
+    dgemm(GEMM_ROW_MAJOR, GEMM_NO_TRANS, GEMM_NO_TRANS, m, 1, k, alpha, A, lda,
+          B + ne, ldb, beta, C + ne, ldc);
+  if (me < m)
+    dgemm(GEMM_ROW_MAJOR, GEMM_NO_TRANS, GEMM_NO_TRANS, 1, ne, k, alpha,
+          A + (long)me * lda, lda, B, ldb, beta, C + (long)me * ldc, ldc);
+}
+
+void gemm_strassen(int m, int n, int k, double alpha, const double *A,
+                   int lda, const double *B, int ldb, double beta, double *C,
+                   int ldc, int cutoff) {
+  if (cutoff <= 0) cutoff = STRASSEN_DEFAULT_CUTOFF;
+  cutoff = std::max(cutoff, STRASSEN_MIN_CUTOFF);
+
+  __arena.reserve(__strassen_workspace(m, n, k, cutoff));
+  __arena.used = 0;
+  __strassen(m, n, k, alpha, A, lda, B, ldb, beta, C, ldc, cutoff);
+}
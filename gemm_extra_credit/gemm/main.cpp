@@ -1,10 +1,22 @@
+#include <cpuid.h>
+#include <float.h>
+#include <getopt.h>
+#include <linux/perf_event.h>
+#include <math.h>
+#include <omp.h>
 #include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
 
 #include <algorithm>
 #include <fstream>
+#include <functional>
 #include <iostream>
+#include <vector>
 
 #include "CycleTimer.h"
 
@@ -12,14 +24,12 @@
 #include "mkl.h"
 #endif
 
+#include "gemm.h"
 #include "gemm_ispc.h"
 #include "ref_gemm_ispc.h"
 
 #define N_ITERS 3  // how many times to run implementaions for timing
-
-// implement: C = alpha * A x B + beta * C
-extern void gemm(int m, int n, int k, double *A, double *B, double *C,
-                 double alpha, double beta);
+#define N_MEDIAN_RUNS 11  // runs per median, for comparisons within noise
 
 static float toBW(uint64_t bytes, float sec) {
   return static_cast<float>(bytes) / (1024. * 1024. * 1024.) / sec;
@@ -46,17 +56,17 @@ void printMat(const char *name, double *A, int m, int n) {
 int allocMatrices(int m, int n, int k, double **A, double **B, double **C) {
 #if MKL_INSTALLED
   // mkl_malloc aligns allocated memory on 64-byte boundaries for performance
-  *A = (double *)mkl_malloc(m * k * sizeof(double), 64);
-  *B = (double *)mkl_malloc(k * n * sizeof(double), 64);
-  *C = (double *)mkl_malloc(m * n * sizeof(double), 64);
+  *A = (double *)mkl_malloc((size_t)m * k * sizeof(double), 64);
+  *B = (double *)mkl_malloc((size_t)k * n * sizeof(double), 64);
+  *C = (double *)mkl_malloc((size_t)m * n * sizeof(double), 64);
   if (*A == NULL || *B == NULL || *C == NULL) {
     // Could not allocate memory; abort
     return 1;
   }
 #else
-  *A = (double *)malloc(m * k * sizeof(double));
-  *B = (double *)malloc(k * n * sizeof(double));
-  *C = (double *)malloc(m * n * sizeof(double));
+  *A = (double *)malloc((size_t)m * k * sizeof(double));
+  *B = (double *)malloc((size_t)k * n * sizeof(double));
+  *C = (double *)malloc((size_t)m * n * sizeof(double));
   if (*A == NULL || *B == NULL || *C == NULL) {
     return 1;
   }
@@ -66,28 +76,817 @@ int allocMatrices(int m, int n, int k, double **A, double **B, double **C) {
 
 void fillMatrices(int m, int n, int k, double **A, double **B, double **C) {
   // Populate the matrices with some data
-  int i;
-  for (i = 0; i < (m * k); i++) {
+  long i;
+  for (i = 0; i < ((long)m * k); i++) {
     (*A)[i] = ((double)rand() / (double)RAND_MAX);
   }
 
-  for (i = 0; i < (k * n); i++) {
+  for (i = 0; i < ((long)k * n); i++) {
     (*B)[i] = ((double)rand() / (double)RAND_MAX);
   }
 
-  for (i = 0; i < (m * n); i++) {
+  for (i = 0; i < ((long)m * n); i++) {
     (*C)[i] = ((double)rand() / (double)RAND_MAX);
   }
 }
 
+// The reference ISPC GEMM was written for the square, multiple-of-8
+// sizes of the assignment, and gives wrong results on other shapes
+static bool ispcSupported(int m, int n, int k) {
+  return m == n && n == k && m % 8 == 0;
+}
+
+// Plain triple loop, to check the other shapes against when MKL is not
+// installed
+static void naiveGemm(int m, int n, int k, double *A, double *B, double *C,
+                      double alpha, double beta) {
+  double *row = (double *)malloc(n * sizeof(double));
+  for (int i = 0; i < m; i++) {
+    for (int j = 0; j < n; j++) row[j] = 0.0;
+    for (int p = 0; p < k; p++) {
+      double a = A[(long)i * k + p];
+      for (int j = 0; j < n; j++) row[j] += a * B[(long)p * n + j];
+    }
+    for (int j = 0; j < n; j++)
+      C[(long)i * n + j] = alpha * row[j] + beta * C[(long)i * n + j];
+  }
+  free(row);
+}
+
+// Element (i, j) of op(X), for X stored with leading dimension ld
+static double opElem(const double *X, gemm_layout layout, gemm_transpose t,
+                     int ld, int i, int j) {
+  bool rows = (layout == GEMM_ROW_MAJOR) == (t == GEMM_NO_TRANS);
+  return rows ? X[(long)i * ld + j] : X[i + (long)j * ld];
+}
+
+static double *cElem(double *C, gemm_layout layout, int ldc, int i, int j) {
+  return layout == GEMM_ROW_MAJOR ? &C[(long)i * ldc + j]
+                                  : &C[i + (long)j * ldc];
+}
+
+// Runs dgemm for both layouts and all transposes, on views into the
+// middle of larger buffers, and returns the largest difference from
+// cblas_dgemm (or from a naive loop without MKL) over the whole
+// buffer of C, so writes outside of the view count as errors too.
+static double checkDgemm() {
+  const int m = 67, n = 45, k = 53;
+  const int ld = 80, offset = 5 * ld + 3;
+  const long size = (long)ld * ld;
+  const double alpha = 0.7, beta = -1.3;
+  const gemm_layout layouts[] = {GEMM_ROW_MAJOR, GEMM_COL_MAJOR};
+  const gemm_transpose trans[] = {GEMM_NO_TRANS, GEMM_TRANS};
+
+  double *A = (double *)malloc(size * sizeof(double));
+  double *B = (double *)malloc(size * sizeof(double));
+  double *C = (double *)malloc(size * sizeof(double));
+  double *ref = (double *)malloc(size * sizeof(double));
+  for (long i = 0; i < size; i++) {
+    A[i] = (double)rand() / RAND_MAX;
+    B[i] = (double)rand() / RAND_MAX;
+  }
+
+  double maxErr = 0.0;
+  for (gemm_layout layout : layouts) {
+    for (gemm_transpose ta : trans) {
+      for (gemm_transpose tb : trans) {
+        for (long i = 0; i < size; i++) C[i] = ref[i] = (double)rand() / RAND_MAX;
+
+        dgemm(layout, ta, tb, m, n, k, alpha, A + offset, ld, B + offset, ld,
+              beta, C + offset, ld);
+#if MKL_INSTALLED
+        cblas_dgemm(layout == GEMM_ROW_MAJOR ? CblasRowMajor : CblasColMajor,
+                    ta == GEMM_NO_TRANS ? CblasNoTrans : CblasTrans,
+                    tb == GEMM_NO_TRANS ? CblasNoTrans : CblasTrans, m, n, k,
+                    alpha, A + offset, ld, B + offset, ld, beta, ref + offset,
+                    ld);
+#else
+        for (int i = 0; i < m; i++) {
+          for (int j = 0; j < n; j++) {
+            double sum = 0.0;
+            for (int p = 0; p < k; p++)
+              sum += opElem(A + offset, layout, ta, ld, i, p) *
+                     opElem(B + offset, layout, tb, ld, p, j);
+            double *c = cElem(ref + offset, layout, ld, i, j);
+            *c = alpha * sum + beta * *c;
+          }
+        }
+#endif
+        for (long i = 0; i < size; i++)
+          maxErr = std::max(maxErr, fabs(C[i] - ref[i]));
+      }
+    }
+  }
+
+  free(A);
+  free(B);
+  free(C);
+  free(ref);
+  return maxErr;
+}
+
+// Best time of the student GEMM on each thread count, next to the
+// speedup over the first count
+static void threadScaling(int m, int n, int k, const std::vector<int> &threads,
+                          double *A, double *B, double *C) {
+  const double flops = 2.0 * m * n * k;
+  double base = 0.0;
+  printf("Thread scaling (student GEMM, best of %d):\n", N_ITERS);
+  printf("  %7s %10s %8s %8s\n", "Threads", "ms", "GFLOPS", "Speedup");
+  for (int t : threads) {
+    omp_set_num_threads(t);
+    double best = 1e30;
+    for (int i = 0; i < N_ITERS; i++) {
+      double startTime = CycleTimer::currentSeconds();
+      gemm(m, n, k, A, B, C, 1.0, 0.0);
+      best = std::min(best, CycleTimer::currentSeconds() - startTime);
+    }
+    if (base == 0.0) base = best;
+    printf("  %7d %10.3f %8.2f %7.2fx\n", t, best * 1000, flops / best / 1e9,
+           base / best);
+  }
+}
+
+// Best time of N_ITERS runs of f
+template <class F>
+static double bestTime(F f) {
+  double best = 1e30;
+  for (int i = 0; i < N_ITERS; i++) {
+    double startTime = CycleTimer::currentSeconds();
+    f();
+    best = std::min(best, CycleTimer::currentSeconds() - startTime);
+  }
+  return best;
+}
+
+// Median times of N_MEDIAN_RUNS runs of each of fs.  The functions take
+// turns, so that a slow stretch of the machine hits all of them alike
+// instead of whichever happened to run then.
+static std::vector<double> medianTimes(
+    const std::vector<std::function<void()>> &fs) {
+  std::vector<std::vector<double>> times(fs.size());
+  for (int i = 0; i < N_MEDIAN_RUNS; i++) {
+    for (size_t f = 0; f < fs.size(); f++) {
+      double startTime = CycleTimer::currentSeconds();
+      fs[f]();
+      times[f].push_back(CycleTimer::currentSeconds() - startTime);
+    }
+  }
+  std::vector<double> medians;
+  for (std::vector<double> &t : times) {
+    std::sort(t.begin(), t.end());
+    medians.push_back(t[t.size() / 2]);
+  }
+  return medians;
+}
+
+// Times dgemm, sgemm and igemm on the same shape, and checks the two
+// lower precisions against dgemm: sgemm on the same (float) inputs,
+// to its rounding error relative to the largest entry of C, and igemm
+// on the same integers, which dgemm multiplies exactly.
+static void comparePrecisions(int m, int n, int k) {
+  const long sizeA = (long)m * k, sizeB = (long)k * n, sizeC = (long)m * n;
+  std::vector<double> Ad(sizeA), Bd(sizeB), Cd(sizeC);
+  std::vector<float> As(sizeA), Bs(sizeB), Cs(sizeC);
+  std::vector<int8_t> Ai(sizeA), Bi(sizeB);
+  std::vector<int32_t> Ci(sizeC);
+  std::vector<double> Aid(sizeA), Bid(sizeB), Cid(sizeC);
+  for (long i = 0; i < sizeA; i++) {
+    As[i] = (float)rand() / RAND_MAX;
+    Ad[i] = As[i];
+    Ai[i] = (int8_t)(rand() % 256 - 128);
+    Aid[i] = Ai[i];
+  }
+  for (long i = 0; i < sizeB; i++) {
+    Bs[i] = (float)rand() / RAND_MAX;
+    Bd[i] = Bs[i];
+    Bi[i] = (int8_t)(rand() % 256 - 128);
+    Bid[i] = Bi[i];
+  }
+
+  double dTime = bestTime([&] {
+    dgemm(GEMM_ROW_MAJOR, GEMM_NO_TRANS, GEMM_NO_TRANS, m, n, k, 1.0,
+          Ad.data(), k, Bd.data(), n, 0.0, Cd.data(), n);
+  });
+  double sTime = bestTime([&] {
+    sgemm(GEMM_ROW_MAJOR, GEMM_NO_TRANS, GEMM_NO_TRANS, m, n, k, 1.0f,
+          As.data(), k, Bs.data(), n, 0.0f, Cs.data(), n);
+  });
+  double iTime = bestTime([&] {
+    igemm(GEMM_ROW_MAJOR, GEMM_NO_TRANS, GEMM_NO_TRANS, m, n, k, 1, Ai.data(),
+          k, Bi.data(), n, 0, Ci.data(), n);
+  });
+  dgemm(GEMM_ROW_MAJOR, GEMM_NO_TRANS, GEMM_NO_TRANS, m, n, k, 1.0,
+        Aid.data(), k, Bid.data(), n, 0.0, Cid.data(), n);
+
+  double maxC = 0.0, sErr = 0.0;
+  long iWrong = 0;
+  for (long i = 0; i < sizeC; i++) {
+    maxC = std::max(maxC, fabs(Cd[i]));
+    sErr = std::max(sErr, fabs(Cs[i] - Cd[i]));
+    if (Ci[i] != Cid[i]) iWrong++;
+  }
+  sErr /= maxC;
+
+  const double ops = 2.0 * m * n * k;
+  printf("Precisions (best of %d):\n", N_ITERS);
+  printf("  %-6s %10s %8s %8s\n", "", "ms", "G(FL)OPS", "vs. f64");
+  printf("  %-6s %10.3f %8.2f %7.2fx\n", "dgemm", dTime * 1000,
+         ops / dTime / 1e9, 1.0);
+  printf("  %-6s %10.3f %8.2f %7.2fx\n", "sgemm", sTime * 1000,
+         ops / sTime / 1e9, dTime / sTime);
+  printf("  %-6s %10.3f %8.2f %7.2fx\n", "igemm", iTime * 1000,
+         ops / iTime / 1e9, dTime / iTime);
+  printf("sgemm vs. dgemm: max error %g of the largest entry\n", sErr);
+  printf("igemm vs. dgemm: %ld of %ld entries differ\n", iWrong, sizeC);
+
+  // Each entry is a sum of k products, each rounded once
+  if (!(sErr < k * FLT_EPSILON)) printf("sgemm is not correct\n");
+  if (iWrong != 0) printf("igemm is not correct\n");
+}
+
+// Largest number of Strassen-Winograd levels timed
+#define STRASSEN_MAX_LEVELS 3
+
+// Cutoff for the given number of Strassen-Winograd levels on an
+// m x n x k product, or 0 if the quadrants would be too small
+static int strassenCutoff(int m, int n, int k, int levels) {
+  int cutoff = std::min(m, std::min(n, k)) >> levels;
+  return cutoff >= 128 ? cutoff : 0;
+}
+
+// Speedup one level at most can have: 8 products become 7
+#define STRASSEN_LEVEL_BOUND (8.0 / 7.0)
+
+// Times dgemm and gemm_strassen with 1 .. STRASSEN_MAX_LEVELS levels on
+// an m x n x k product, by median of runs taking turns, with the
+// squared error of each against the reference (cblas_dgemm, or dgemm
+// without MKL).  A speedup above (8/7)^levels is more than the saved
+// products can give, and is flagged rather than believed.
+static void compareStrassen(int m, int n, int k) {
+  const long sizeC = (long)m * n;
+  std::vector<double> A((long)m * k), B((long)k * n), C(sizeC), ref(sizeC);
+  for (double &x : A) x = (double)rand() / RAND_MAX;
+  for (double &x : B) x = (double)rand() / RAND_MAX;
+
+#if MKL_INSTALLED
+  cblas_dgemm(CblasRowMajor, CblasNoTrans, CblasNoTrans, m, n, k, 1.0,
+              A.data(), k, B.data(), n, 0.0, ref.data(), n);
+#endif
+  auto classical = [&] {
+    dgemm(GEMM_ROW_MAJOR, GEMM_NO_TRANS, GEMM_NO_TRANS, m, n, k, 1.0, A.data(),
+          k, B.data(), n, 0.0, C.data(), n);
+  };
+  std::vector<int> cutoffs;
+  std::vector<std::function<void()>> runs = {classical};
+  for (int levels = 1; levels <= STRASSEN_MAX_LEVELS; levels++) {
+    int cutoff = strassenCutoff(m, n, k, levels);
+    if (cutoff == 0) break;
+    cutoffs.push_back(cutoff);
+    runs.push_back([&, cutoff] {
+      gemm_strassen(m, n, k, 1.0, A.data(), k, B.data(), n, 0.0, C.data(), n,
+                    cutoff);
+    });
+  }
+  std::vector<double> times = medianTimes(runs);
+
+  classical();
+#if !MKL_INSTALLED
+  ref = C;
+#endif
+  auto sqErr = [&] {
+    double err = 0.0;
+    for (long i = 0; i < sizeC; i++) err += (C[i] - ref[i]) * (C[i] - ref[i]);
+    return err;
+  };
+
+  const double flops = 2.0 * m * n * k;
+  printf("Strassen-Winograd (median of %d, GFLOPS of the classical count):\n",
+         N_MEDIAN_RUNS);
+  printf("  %-8s %7s %10s %8s %8s %8s %12s\n", "", "cutoff", "ms", "GFLOPS",
+         "Speedup", "Bound", "Sq. error");
+  printf("  %-8s %7s %10.3f %8.2f %7.2fx %8s %12.4g\n", "dgemm", "-",
+         times[0] * 1000, flops / times[0] / 1e9, 1.0, "-", sqErr());
+  bool overBound = false;
+  for (size_t i = 0; i < cutoffs.size(); i++) {
+    int levels = i + 1;
+    double time = times[i + 1], bound = pow(STRASSEN_LEVEL_BOUND, levels);
+    runs[i + 1]();
+    char name[16];
+    snprintf(name, sizeof(name), "%d level%s", levels, levels > 1 ? "s" : "");
+    printf("  %-8s %7d %10.3f %8.2f %7.2fx %7.2fx %12.4g%s\n", name,
+           cutoffs[i], time * 1000, flops / time / 1e9, times[0] / time, bound,
+           sqErr(), times[0] / time > bound ? " *" : "");
+    overBound |= times[0] / time > bound;
+  }
+  if (cutoffs.empty())
+    printf("  (too small for a level: every dimension must be at least 256)\n");
+  if (overBound)
+    printf("  * above the bound: noise, or dgemm faster on the smaller "
+           "products\n");
+}
+
+// Median speedup of one level of gemm_strassen over dgemm on square
+// sizes from 256 up to maxSize, in steps of 1.5x and 4/3x.  One level
+// at a size is exactly the choice the cutoff makes there, so the
+// cutoff to use is the largest size where the level still lost: with
+// it, gemm_strassen recurses only on the sizes where a level won.
+static void strassenCrossover(int maxSize) {
+  printf("Strassen-Winograd crossover (1 level, median of %d):\n",
+         N_MEDIAN_RUNS);
+  printf("  %7s %8s\n", "Size", "Speedup");
+  std::vector<int> sizes;
+  for (int size = 256; size <= maxSize; size *= 2) {
+    sizes.push_back(size);
+    if (size * 3 / 2 <= maxSize) sizes.push_back(size * 3 / 2);
+  }
+  // Largest size where the level lost, or the one below the first size
+  int cutoff = 128;
+  for (int size : sizes) {
+    std::vector<double> A((long)size * size), B((long)size * size);
+    std::vector<double> C((long)size * size);
+    for (double &x : A) x = (double)rand() / RAND_MAX;
+    for (double &x : B) x = (double)rand() / RAND_MAX;
+    std::vector<double> times = medianTimes({
+        [&] {
+          dgemm(GEMM_ROW_MAJOR, GEMM_NO_TRANS, GEMM_NO_TRANS, size, size, size,
+                1.0, A.data(), size, B.data(), size, 0.0, C.data(), size);
+        },
+        [&] {
+          gemm_strassen(size, size, size, 1.0, A.data(), size, B.data(), size,
+                        0.0, C.data(), size, size / 2);
+        },
+    });
+    double speedup = times[0] / times[1];
+    printf("  %7d %7.2fx%s\n", size, speedup,
+           speedup > STRASSEN_LEVEL_BOUND ? " (above the 1.14x bound)" : "");
+    if (speedup <= 1.0) cutoff = size;
+  }
+  if (cutoff < sizes.back())
+    printf("  one level wins above %d: use cutoff %d\n", cutoff, cutoff);
+  else
+    printf("  one level does not win up to size %d\n", maxSize);
+}
+
+// Times a bias and ReLU after dgemm on an m x n x k product, as a
+// second pass over C and fused into dgemm_fused, and checks the fused
+// result against the separate pass.  The second pass reads and writes
+// all of C, 2 x M x N doubles, which fusion avoids; what it saves is
+// the measured difference, which is only positive if the epilogue in
+// the kernels costs less than the pass.
+static void compareEpilogue(int m, int n, int k) {
+  const long sizeC = (long)m * n;
+  std::vector<double> A((long)m * k), B((long)k * n), bias(n);
+  std::vector<double> C(sizeC), Cf(sizeC), P(sizeC);
+  for (double &x : A) x = (double)rand() / RAND_MAX - 0.5;
+  for (double &x : B) x = (double)rand() / RAND_MAX - 0.5;
+  for (double &x : bias) x = (double)rand() / RAND_MAX - 0.5;
+
+  auto epiloguePass = [&](double *X) {
+#pragma omp parallel for schedule(static)
+    for (int i = 0; i < m; i++) {
+      double *row = X + (long)i * n;
+      for (int j = 0; j < n; j++) row[j] = std::max(row[j] + bias[j], 0.0);
+    }
+  };
+  gemm_epilogue relu = {bias.data(), GEMM_RELU, 0.0, 0.0};
+  std::vector<double> times = medianTimes({
+      [&] {
+        dgemm(GEMM_ROW_MAJOR, GEMM_NO_TRANS, GEMM_NO_TRANS, m, n, k, 1.0,
+              A.data(), k, B.data(), n, 0.0, C.data(), n);
+        epiloguePass(C.data());
+      },
+      [&] {
+        dgemm_fused(GEMM_ROW_MAJOR, GEMM_NO_TRANS, GEMM_NO_TRANS, m, n, k, 1.0,
+                    A.data(), k, B.data(), n, 0.0, Cf.data(), n, &relu);
+      },
+      // The pass on its own, on a copy so that C keeps its result
+      [&] {
+        P = C;
+        epiloguePass(P.data());
+      },
+      [&] { P = C; },
+  });
+  const double unfused = times[0], fused = times[1];
+  const double passTime = std::max(times[2] - times[3], 0.0);
+
+  double err = 0.0;
+  for (long i = 0; i < sizeC; i++) err = std::max(err, fabs(Cf[i] - C[i]));
+
+  const double bytes = 2.0 * sizeC * sizeof(double);
+  printf("Bias + ReLU epilogue on %d x %d x %d (median of %d):\n", m, n, k,
+         N_MEDIAN_RUNS);
+  printf("  %10s %10s %8s %9s\n", "dgemm+pass", "fused ms", "Speedup",
+         "Saved ms");
+  printf("  %10.3f %10.3f %7.2fx %9.3f\n", unfused * 1000, fused * 1000,
+         unfused / fused, (unfused - fused) * 1000);
+  printf("  The separate pass: %.3f ms for %.1f MB of C traffic (%.2f GB/s)\n",
+         passTime * 1000, bytes / 1e6, toBW((uint64_t)bytes, passTime));
+  printf("  dgemm_fused vs. dgemm and a pass: max difference %g\n", err);
+  if (!(err == 0.0)) printf("dgemm_fused is not correct\n");
+}
+
+// The first implementations in gemm.cpp, which gemm no longer calls,
+// for the roofline
+void __gemm_naive(int m, int n, int k, double *A, double *B, double *C,
+                  double alpha, double beta);
+void __gemm_blocking(int m, int n, int k, double *A, double *B, double *C,
+                     double alpha, double beta);
+
+// Independent FMA chains per thread in the peak FLOPS loop: enough to
+// cover the latency of the FMA units (4 cycles x 2 units) with some to
+// spare, few enough to stay in registers
+#define PEAK_CHAINS 12
+#define PEAK_ITERS (1 << 22)
+
+// Size of each array of the triad when the last level cache size is
+// unknown
+#define STREAM_DEFAULT_BYTES (256L << 20)
+
+// The naive and legacy blocked GEMMs are timed (once) only up to this
+// many flops, about a 1024 x 1024 x 1024 product
+#define ROOFLINE_MAX_SLOW_FLOPS 2.2e9
+
+// 256-bit and 512-bit vectors of doubles
+typedef double vec4d __attribute__((vector_size(32)));
+typedef double vec8d __attribute__((vector_size(64)));
+
+static volatile double peakSink;
+
+// GFLOPS of FMAs on vec on all threads, with nothing to load or store:
+// the peak of the FP units for that vector width
+template <class vec>
+static double peakGflops() {
+  constexpr int V = sizeof(vec) / sizeof(double);
+  double best = 1e30;
+  int threads = 1;
+  for (int rep = 0; rep < N_ITERS; rep++) {
+    double startTime = CycleTimer::currentSeconds();
+#pragma omp parallel
+    {
+      threads = omp_get_num_threads();
+      // acc = acc * x + y, which settles at y / (1 - x) without
+      // overflowing or going subnormal
+      vec acc[PEAK_CHAINS];
+      vec x = vec{} + 0.5, y = vec{} + (double)omp_get_thread_num();
+      for (int c = 0; c < PEAK_CHAINS; c++) acc[c] = vec{} + (double)c;
+      for (long i = 0; i < PEAK_ITERS; i++) {
+#pragma GCC unroll 16
+        for (int c = 0; c < PEAK_CHAINS; c++) acc[c] = acc[c] * x + y;
+      }
+      // Every lane of every chain is used, so that none of the loop can
+      // be optimized away
+      double sum = 0.0;
+      for (int c = 0; c < PEAK_CHAINS; c++)
+        for (int l = 0; l < V; l++) sum += acc[c][l];
+#pragma omp critical
+      peakSink = peakSink + sum;
+    }
+    best = std::min(best, CycleTimer::currentSeconds() - startTime);
+  }
+  return 2.0 * V * PEAK_CHAINS * PEAK_ITERS * threads / best / 1e9;
+}
+
+// GB/s of the STREAM triad a = b + s * c on all threads, over arrays
+// twice the size of the last level cache each, counting 3 x 8 bytes per
+// element as STREAM does (not the read for ownership of a)
+static double streamBandwidth() {
+  long llc = sysconf(_SC_LEVEL3_CACHE_SIZE);
+  long count = (llc > 0 ? 2 * llc : STREAM_DEFAULT_BYTES) / sizeof(double);
+  double *a = (double *)aligned_alloc(64, count * sizeof(double));
+  double *b = (double *)aligned_alloc(64, count * sizeof(double));
+  double *c = (double *)aligned_alloc(64, count * sizeof(double));
+  // First touch by the threads that stream through them
+#pragma omp parallel for schedule(static)
+  for (long i = 0; i < count; i++) {
+    a[i] = 0.0;
+    b[i] = 1.0;
+    c[i] = 2.0;
+  }
+  const double scalar = 3.0;
+  double best = bestTime([&] {
+#pragma omp parallel for schedule(static)
+    for (long i = 0; i < count; i++) a[i] = b[i] + scalar * c[i];
+  });
+  free(a);
+  free(b);
+  free(c);
+  return 3.0 * count * sizeof(double) / best / 1e9;
+}
+
+// Hardware counters, read with perf_event_open.  The floating point
+// ones are Intel's FP_ARITH_INST_RETIRED events, by vector width, which
+// count an FMA twice, so that scalar + 2 x 128-bit + 4 x 256-bit +
+// 8 x 512-bit is the number of double precision flops executed.
+enum hw_counter {
+  HW_L1D_MISSES,
+  HW_LLC_MISSES,
+  HW_FP_SCALAR,
+  HW_FP_128,
+  HW_FP_256,
+  HW_FP_512,
+  NUM_HW_COUNTERS
+};
+
+// Counters of the OpenMP threads: each thread of the team opens its
+// own, so threads started in some other way (the tasks of the ISPC
+// reference) are not counted
+struct hw_counters {
+  std::vector<int> fds;
+  bool valid[NUM_HW_COUNTERS];
+  double values[NUM_HW_COUNTERS];
+};
+
+static int perfOpen(uint32_t type, uint64_t config) {
+  perf_event_attr attr;
+  memset(&attr, 0, sizeof(attr));
+  attr.size = sizeof(attr);
+  attr.type = type;
+  attr.config = config;
+  attr.disabled = 1;
+  attr.exclude_kernel = 1;
+  attr.exclude_hv = 1;
+  // To scale the counts up if the counters are multiplexed
+  attr.read_format =
+      PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+  return syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+}
+
+static bool isIntel() {
+  unsigned int eax, ebx, ecx, edx;
+  if (!__get_cpuid(0, &eax, &ebx, &ecx, &edx)) return false;
+  // "GenuineIntel" in ebx, edx, ecx
+  return ebx == 0x756e6547 && edx == 0x49656e69 && ecx == 0x6c65746e;
+}
+
+static void perfClose(hw_counters *counters) {
+  for (int fd : counters->fds)
+    if (fd >= 0) close(fd);
+  counters->fds.clear();
+}
+
+// Returns false (with nothing left open) if not even the cache misses
+// can be counted, e.g. because of kernel.perf_event_paranoid or because
+// a virtual machine has no PMU.  The floating point counters may be
+// missing on their own (on other vendors, or with too few counters).
+static bool perfInit(hw_counters *counters) {
+  const uint64_t l1dMisses = PERF_COUNT_HW_CACHE_L1D |
+                             (PERF_COUNT_HW_CACHE_OP_READ << 8) |
+                             (PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+  // FP_ARITH_INST_RETIRED: event 0xc7, one umask per width
+  const uint64_t fpUmasks[] = {0x01, 0x04, 0x10, 0x40};
+  const bool intel = isIntel();
+  for (int c = 0; c < NUM_HW_COUNTERS; c++) counters->valid[c] = true;
+#pragma omp parallel
+  {
+    int fds[NUM_HW_COUNTERS];
+    fds[HW_L1D_MISSES] = perfOpen(PERF_TYPE_HW_CACHE, l1dMisses);
+    fds[HW_LLC_MISSES] =
+        perfOpen(PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES);
+    for (int w = 0; w < 4; w++)
+      fds[HW_FP_SCALAR + w] =
+          intel ? perfOpen(PERF_TYPE_RAW, 0xc7 | fpUmasks[w] << 8) : -1;
+#pragma omp critical
+    for (int c = 0; c < NUM_HW_COUNTERS; c++) {
+      counters->fds.push_back(fds[c]);
+      if (fds[c] < 0) counters->valid[c] = false;
+    }
+  }
+  if (!counters->valid[HW_L1D_MISSES] || !counters->valid[HW_LLC_MISSES]) {
+    perfClose(counters);
+    return false;
+  }
+  return true;
+}
+
+static void perfStart(hw_counters *counters) {
+  for (int fd : counters->fds) {
+    if (fd < 0) continue;
+    ioctl(fd, PERF_EVENT_IOC_RESET, 0);
+    ioctl(fd, PERF_EVENT_IOC_ENABLE, 0);
+  }
+}
+
+static void perfStop(hw_counters *counters) {
+  for (int c = 0; c < NUM_HW_COUNTERS; c++) counters->values[c] = 0.0;
+  for (size_t i = 0; i < counters->fds.size(); i++) {
+    int fd = counters->fds[i];
+    if (fd < 0) continue;
+    ioctl(fd, PERF_EVENT_IOC_DISABLE, 0);
+    // value, time enabled, time running
+    uint64_t v[3];
+    if (read(fd, v, sizeof(v)) == sizeof(v) && v[2] > 0)
+      counters->values[i % NUM_HW_COUNTERS] += (double)v[0] * v[1] / v[2];
+  }
+}
+
+// An implementation on the roofline: run computes C = A x B + C on the
+// m x n x k buffers of roofline()
+struct roofline_impl {
+  const char *name;
+  std::function<void()> run;
+  // Timed once instead of best of N_ITERS, and only up to
+  // ROOFLINE_MAX_SLOW_FLOPS
+  bool slow;
+};
+
+// Places each implementation on the roofline of this machine: its
+// GFLOPS against the attainable min(peak, intensity x bandwidth) at the
+// intensity of the product (flops per byte of A, B and C moved once
+// each, which no implementation can beat).  With counters, the traffic
+// the last level cache actually missed on gives the intensity each
+// implementation achieved, the L1D misses how well it reused its
+// blocks, and the flops counted by vector width how much of the work
+// was vectorized.
+static void roofline(int m, int n, int k, bool counters) {
+  const long sizeA = (long)m * k, sizeB = (long)k * n, sizeC = (long)m * n;
+  std::vector<double> A(sizeA), B(sizeB), C(sizeC);
+  for (double &x : A) x = (double)rand() / RAND_MAX;
+  for (double &x : B) x = (double)rand() / RAND_MAX;
+  for (double &x : C) x = (double)rand() / RAND_MAX;
+  const double flops = 2.0 * m * n * k;
+  const double bytes = (sizeA + sizeB + 2.0 * sizeC) * sizeof(double);
+  const double intensity = flops / bytes;
+
+  double peak256 = peakGflops<vec4d>();
+#ifdef __AVX512F__
+  double peak = std::max(peak256, peakGflops<vec8d>());
+#else
+  double peak = peak256;
+#endif
+  double bandwidth = streamBandwidth();
+  printf("Roofline (%d threads):\n", omp_get_max_threads());
+  printf("  peak %.2f GFLOPS (%.2f with the 256-bit FMAs of dgemm), "
+         "stream triad %.2f GB/s\n", peak, peak256, bandwidth);
+  const double roof = std::min(peak, intensity * bandwidth);
+  printf("  ridge at %.2f flops/byte; this product: %.2f flops/byte, "
+         "roof %.2f GFLOPS\n", peak / bandwidth, intensity, roof);
+
+  std::vector<roofline_impl> impls;
+  impls.push_back({"naive", [&] {
+                     __gemm_naive(m, n, k, A.data(), B.data(), C.data(), 1.0,
+                                  1.0);
+                   }, true});
+  impls.push_back({"blocking", [&] {
+                     __gemm_blocking(m, n, k, A.data(), B.data(), C.data(),
+                                     1.0, 1.0);
+                   }, true});
+  impls.push_back({"student", [&] {
+                     gemm(m, n, k, A.data(), B.data(), C.data(), 1.0, 1.0);
+                   }, false});
+  if (ispcSupported(m, n, k))
+    impls.push_back({"ref ispc", [&] {
+                       ispc::gemm_ispc_ref(m, n, k, A.data(), B.data(),
+                                           C.data(), 1.0, 1.0);
+                     }, false});
+#if MKL_INSTALLED
+  impls.push_back({"mkl", [&] {
+                     cblas_dgemm(CblasRowMajor, CblasNoTrans, CblasNoTrans, m,
+                                 n, k, 1.0, A.data(), k, B.data(), n, 1.0,
+                                 C.data(), n);
+                   }, false});
+#endif
+
+  hw_counters hw;
+  bool haveCounters = counters && perfInit(&hw);
+  if (counters && !haveCounters)
+    printf("  Hardware counters are not available (no PMU in this machine "
+           "or VM, or see\n  /proc/sys/kernel/perf_event_paranoid)\n");
+  bool haveFp = haveCounters && hw.valid[HW_FP_SCALAR] &&
+                hw.valid[HW_FP_128] && hw.valid[HW_FP_256] &&
+                hw.valid[HW_FP_512];
+
+  printf("  %-9s %10s %8s %7s", "", "ms", "GFLOPS", "% roof");
+  if (haveCounters)
+    printf(" %11s %9s %11s", "L1D miss/kf", "LLC MB", "flops/B LLC");
+  if (haveFp) printf(" %9s %8s", "FP/2MNK", "% vector");
+  printf("\n");
+
+  for (const roofline_impl &impl : impls) {
+    if (impl.slow && flops > ROOFLINE_MAX_SLOW_FLOPS) {
+      printf("  %-9s (skipped: too slow at this size)\n", impl.name);
+      continue;
+    }
+    // The counters are read on one run of its own, after the timed ones
+    // (the only run of a slow implementation)
+    double time;
+    if (impl.slow) {
+      if (haveCounters) perfStart(&hw);
+      double startTime = CycleTimer::currentSeconds();
+      impl.run();
+      time = CycleTimer::currentSeconds() - startTime;
+      if (haveCounters) perfStop(&hw);
+    } else {
+      time = bestTime(impl.run);
+      if (haveCounters) {
+        perfStart(&hw);
+        impl.run();
+        perfStop(&hw);
+      }
+    }
+
+    double gflops = flops / time / 1e9;
+    printf("  %-9s %10.3f %8.2f %6.1f%%", impl.name, time * 1000, gflops,
+           100.0 * gflops / roof);
+    if (haveCounters) {
+      double llcBytes = hw.values[HW_LLC_MISSES] * 64.0;
+      printf(" %11.2f %9.1f %11.2f", hw.values[HW_L1D_MISSES] / flops * 1000,
+             llcBytes / 1e6, llcBytes > 0 ? flops / llcBytes : 0.0);
+    }
+    if (haveFp) {
+      const double *v = hw.values;
+      double vector = 2 * v[HW_FP_128] + 4 * v[HW_FP_256] + 8 * v[HW_FP_512];
+      double counted = v[HW_FP_SCALAR] + vector;
+      printf(" %9.2f %7.1f%%", counted / flops,
+             counted > 0 ? 100.0 * vector / counted : 0.0);
+    }
+    printf("\n");
+  }
+  if (haveCounters) perfClose(&hw);
+}
+
+void usage(const char *binary_name) {
+  fprintf(stderr,
+          "Usage: %s [-t threads] [-S] [-R] [-p] <size> | <M> <N> <K>\n",
+          binary_name);
+  fprintf(stderr,
+          "  Multiplies an M x K by a K x N matrix (size x size by size x "
+          "size).\n");
+  fprintf(stderr, "  Dimensions need not be multiples of any block size.\n");
+  fprintf(stderr,
+          "  -t LIST  also time the student GEMM on these thread counts, "
+          "comma\n           separated, or 'all' for 1, 2, 4, ..., max\n");
+  fprintf(stderr,
+          "  -S       also find the cutoff for gemm_strassen, where one "
+          "level\n           starts to beat dgemm, on square sizes from 256 "
+          "up to\n           the largest dimension\n");
+  fprintf(stderr,
+          "  -R       also measure the peak FLOPS and stream bandwidth of "
+          "this\n           machine and place each GEMM on its roofline\n");
+  fprintf(stderr,
+          "  -p       -R, with cache misses and flops read from hardware "
+          "counters\n           with perf_event_open, where permitted\n");
+}
+
 // Compute C=alpha*A*B+beta*C using Intel MKL and your implementation
 int main(int argc, char *argv[]) {
   // Problem size calculations
   int m, n, k;
-  int size = atoi(argv[1]);
-  m = size, k = size, n = size;
-  const uint64_t TOTAL_BYTES = (m * k + k * n + 2 * m * n) * sizeof(double);
-  const uint64_t TOTAL_FLOPS = 2 * m * ((uint64_t)n * k);
+  std::vector<int> threads;
+  bool crossover = false;
+  bool runRoofline = false, counters = false;
+  int opt;
+  while ((opt = getopt(argc, argv, "t:SRph")) != EOF) {
+    switch (opt) {
+      case 't':
+        if (!strcmp(optarg, "all")) {
+          int max_threads = omp_get_max_threads();
+          for (int t = 1; t < max_threads; t *= 2) threads.push_back(t);
+          threads.push_back(max_threads);
+        } else {
+          for (char *t = strtok(optarg, ","); t; t = strtok(NULL, ","))
+            threads.push_back(std::max(1, atoi(t)));
+        }
+        break;
+      case 'S':
+        crossover = true;
+        break;
+      case 'R':
+        runRoofline = true;
+        break;
+      case 'p':
+        runRoofline = counters = true;
+        break;
+      case 'h':
+      default:
+        usage(argv[0]);
+        return 1;
+    }
+  }
+
+  int nargs = argc - optind;
+  if (nargs == 1) {
+    m = k = n = atoi(argv[optind]);
+  } else if (nargs == 3) {
+    m = atoi(argv[optind]);
+    n = atoi(argv[optind + 1]);
+    k = atoi(argv[optind + 2]);
+  } else {
+    usage(argv[0]);
+    return 1;
+  }
+  if (m <= 0 || n <= 0 || k <= 0) {
+    usage(argv[0]);
+    return 1;
+  }
+  printf("M = %d, N = %d, K = %d\n", m, n, k);
+  gemm_config config = gemm_get_config();
+  printf("dgemm: %dx%d tile, MC = %d, KC = %d, NC = %d\n", config.mr,
+         config.nr, config.mc, config.kc, config.nc);
+  const bool runISPC = ispcSupported(m, n, k);
+  const uint64_t TOTAL_BYTES =
+      ((uint64_t)m * k + (uint64_t)k * n + 2 * (uint64_t)m * n) * sizeof(double);
+  const uint64_t TOTAL_FLOPS = 2 * (uint64_t)m * n * k;
 
   double alpha, beta;
   alpha = 1.0;
@@ -128,13 +927,13 @@ int main(int argc, char *argv[]) {
     fillMatrices(m, n, k, &A1, &B1, &C1);
 
     // Make a copy of the matrices
-    memcpy(A2, A1, m * k * sizeof(double));
-    memcpy(B2, B1, k * n * sizeof(double));
-    memcpy(C2, C1, m * n * sizeof(double));
+    memcpy(A2, A1, (size_t)m * k * sizeof(double));
+    memcpy(B2, B1, (size_t)k * n * sizeof(double));
+    memcpy(C2, C1, (size_t)m * n * sizeof(double));
 
-    memcpy(A3, A1, m * k * sizeof(double));
-    memcpy(B3, B1, k * n * sizeof(double));
-    memcpy(C3, C1, m * n * sizeof(double));
+    memcpy(A3, A1, (size_t)m * k * sizeof(double));
+    memcpy(B3, B1, (size_t)k * n * sizeof(double));
+    memcpy(C3, C1, (size_t)m * n * sizeof(double));
 
     // Run the Intel MKL matrix multiply implementation.
 #if MKL_INSTALLED
@@ -157,27 +956,34 @@ int main(int argc, char *argv[]) {
     minGEMM = std::min(minGEMM, endTime - startTime);
 
     // Run reference ISPC matrix multiply implementation.
-    printf("Running ref ispc GEMM... ");
-    startTime = CycleTimer::currentSeconds();
-    ispc::gemm_ispc_ref(m, n, k, A3, B3, C3, alpha, beta);
-    endTime = CycleTimer::currentSeconds();
-    printf("%.2lfms\n", (endTime - startTime) * 1000);
-    minISPC = std::min(minISPC, endTime - startTime);
+    if (runISPC) {
+      printf("Running ref ispc GEMM... ");
+      startTime = CycleTimer::currentSeconds();
+      ispc::gemm_ispc_ref(m, n, k, A3, B3, C3, alpha, beta);
+      endTime = CycleTimer::currentSeconds();
+      printf("%.2lfms\n", (endTime - startTime) * 1000);
+      minISPC = std::min(minISPC, endTime - startTime);
+    } else {
+#if !MKL_INSTALLED
+      printf("Running naive GEMM (untimed, for the correctness check)...\n");
+      naiveGemm(m, n, k, A3, B3, C3, alpha, beta);
+#endif
+    }
 
     // Compare output for correctness
     for (int i = 0; i < m; i++) {
       for (int j = 0; j < n; j++) {
 #if MKL_INSTALLED
-        double mkl_output  = C1[i * n + j];
-        double sol_output  = C2[i * n + j];
-        double ispc_output = C3[i * n + j];
+        double mkl_output  = C1[(long)i * n + j];
+        double sol_output  = C2[(long)i * n + j];
+        double ispc_output = C3[(long)i * n + j];
         totalsqerr_user +=
             (mkl_output - sol_output) * (mkl_output - sol_output);
         totalsqerr_ispc +=
             (mkl_output - ispc_output) * (mkl_output - ispc_output);
 #else
-        double sol_output  = C2[i * n + j];
-        double ispc_output = C3[i * n + j];
+        double sol_output  = C2[(long)i * n + j];
+        double ispc_output = C3[(long)i * n + j];
         totalsqerr_user +=
             (ispc_output - sol_output) * (ispc_output - sol_output);
 #endif
@@ -198,13 +1004,39 @@ int main(int argc, char *argv[]) {
          minGEMM * 1000, toBW(TOTAL_BYTES, minGEMM),
          toGFLOPS(TOTAL_FLOPS, minGEMM));
 
-  printf("[Ref ISPC GEMM]:\t[%.3f] ms\t[%.3f] GB/s\t[%.2f] GFLOPS\n",
-         minISPC * 1000, toBW(TOTAL_BYTES, minISPC),
-         toGFLOPS(TOTAL_FLOPS, minISPC));
+  if (runISPC) {
+    printf("[Ref ISPC GEMM]:\t[%.3f] ms\t[%.3f] GB/s\t[%.2f] GFLOPS\n",
+           minISPC * 1000, toBW(TOTAL_BYTES, minISPC),
+           toGFLOPS(TOTAL_FLOPS, minISPC));
+
+    printf("Student GEMM vs. ref ISPC:\t[%.2fx]\n", minISPC / minGEMM);
+  }
+#if MKL_INSTALLED
+  printf("Student GEMM vs. Intel MKL:\t[%.2fx]\n", minMKL / minGEMM);
+#endif
 
   printf("Total squared error student sol: %lf\n", totalsqerr_user);
+
+  double dgemmErr = checkDgemm();
+#if MKL_INSTALLED
+  printf("dgemm layouts/transposes on submatrices vs. cblas_dgemm: max error "
+         "%g\n", dgemmErr);
+#else
+  printf("dgemm layouts/transposes on submatrices vs. naive: max error %g\n",
+         dgemmErr);
+#endif
+  if (!(dgemmErr < 1e-10)) printf("dgemm is not correct\n");
+
+  comparePrecisions(m, n, k);
+  compareStrassen(m, n, k);
+  compareEpilogue(m, n, k);
+  if (k > 64) compareEpilogue(m, n, 64);
+  if (crossover) strassenCrossover(std::max(m, std::max(n, k)));
+  if (runRoofline) roofline(m, n, k, counters);
+
+  if (!threads.empty()) threadScaling(m, n, k, threads, A2, B2, C2);
 #if MKL_INSTALLED
-  printf("Total squared error ref ispc: %lf\n", totalsqerr_ispc);
+  if (runISPC) printf("Total squared error ref ispc: %lf\n", totalsqerr_ispc);
 #endif
 
   // Deallocate matrices
@@ -0,0 +1,160 @@
+#include <getopt.h>
+#include <omp.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <algorithm>
+#include <vector>
+
+#include "CycleTimer.h"
+#include "gemm.h"
+
+// Candidate blocks, rounded down to multiples of the tile
+static const int kcs[] = {64, 128, 192, 256, 384, 512, 768, 1024};
+static const int mcs[] = {48, 96, 144, 192, 288, 384, 576, 768, 1152};
+static const int ncs[] = {256, 512, 1024, 2048, 4096};
+
+struct tuner {
+  int size;
+  int reps;
+  std::vector<double> A, B, C;
+  int measured = 0;
+
+  // Best GFLOPS of reps runs of gemm on size x size matrices with
+  // config, after one untimed run
+  double measure(const gemm_config &config) {
+    gemm_set_config(config);
+    double best = 1e30;
+    for (int i = 0; i <= reps; i++) {
+      double startTime = CycleTimer::currentSeconds();
+      gemm(size, size, size, A.data(), B.data(), C.data(), 1.0, 0.0);
+      double time = CycleTimer::currentSeconds() - startTime;
+      if (i > 0) best = std::min(best, time);
+    }
+    double gflops = 2.0 * size * size * size / best / 1e9;
+    printf("  %2dx%-2d %6d %6d %6d %9.2f\n", config.mr, config.nr, config.mc,
+           config.kc, config.nc, gflops);
+    measured++;
+    return gflops;
+  }
+
+  // Tries the candidates for one block (field of gemm_config), rounded
+  // to multiples of `multiple`, and keeps the best in *config
+  template <size_t N>
+  double sweep(gemm_config *config, int gemm_config::*field,
+               const int (&candidates)[N], int multiple, double best) {
+    gemm_config start = *config;
+    for (int value : candidates) {
+      gemm_config c = start;
+      c.*field = std::max(multiple, value / multiple * multiple);
+      if (c.*field == start.*field) continue;
+      double gflops = measure(c);
+      if (gflops > best) {
+        best = gflops;
+        *config = c;
+      }
+    }
+    return best;
+  }
+};
+
+void usage(const char *binary_name) {
+  fprintf(stderr, "Usage: %s [-s size] [-r reps] [-n]\n", binary_name);
+  fprintf(stderr,
+          "  Searches the register tile and the MC, KC and NC blocks of "
+          "dgemm on\n  this machine and saves the fastest to the tuning file "
+          "(%s),\n  from which gemm loads it at startup.\n",
+          gemm_config_path());
+  fprintf(stderr, "  -s INT  size of the square product timed (default 1024)\n");
+  fprintf(stderr, "  -r INT  timed runs per configuration (default 3)\n");
+  fprintf(stderr, "  -n      only search, do not save\n");
+}
+
+int main(int argc, char *argv[]) {
+  tuner t;
+  t.size = 1024;
+  t.reps = 3;
+  bool save = true;
+  int opt;
+  while ((opt = getopt(argc, argv, "s:r:nh")) != EOF) {
+    switch (opt) {
+      case 's':
+        t.size = atoi(optarg);
+        break;
+      case 'r':
+        t.reps = std::max(1, atoi(optarg));
+        break;
+      case 'n':
+        save = false;
+        break;
+      case 'h':
+      default:
+        usage(argv[0]);
+        return 1;
+    }
+  }
+  if (t.size <= 0) {
+    usage(argv[0]);
+    return 1;
+  }
+
+  long elems = (long)t.size * t.size;
+  t.A.resize(elems);
+  t.B.resize(elems);
+  t.C.resize(elems);
+  for (long i = 0; i < elems; i++) {
+    t.A[i] = (double)rand() / RAND_MAX;
+    t.B[i] = (double)rand() / RAND_MAX;
+  }
+
+  printf("Tuning dgemm on %d x %d x %d, %d threads, best of %d runs\n",
+         t.size, t.size, t.size, omp_get_max_threads(), t.reps);
+  gemm_config current = gemm_get_config();
+  printf("Current: %dx%d, MC %d, KC %d, NC %d\n", current.mr, current.nr,
+         current.mc, current.kc, current.nc);
+  printf("  %5s %6s %6s %6s %9s\n", "tile", "MC", "KC", "NC", "GFLOPS");
+
+  // For each tile, from the analytical blocks: KC first (it sizes the
+  // micro-panels in L1 and the blocks in L2 and L3 both), then MC with
+  // the best KC, then NC.  A sweep over each block in turn rather than
+  // the whole product of the candidates, which would take hours.
+  std::vector<gemm_config> finalists = {current};
+  for (int i = 0; i < GEMM_NUM_TILES; i++) {
+    gemm_config config = gemm_default_config(gemm_tiles[i][0], gemm_tiles[i][1]);
+    double gflops = t.measure(config);
+    gflops = t.sweep(&config, &gemm_config::kc, kcs, 8, gflops);
+    gflops = t.sweep(&config, &gemm_config::mc, mcs, config.mr, gflops);
+    t.sweep(&config, &gemm_config::nc, ncs, config.nr, gflops);
+    finalists.push_back(config);
+  }
+
+  // A single fast run can be luck on a busy machine: the best of each
+  // tile and the current configuration are timed again, for longer,
+  // before one is picked
+  printf("Best of each tile and the current configuration, %d runs:\n",
+         3 * t.reps);
+  t.reps *= 3;
+  gemm_config best = current;
+  double bestGflops = 0.0;
+  for (const gemm_config &config : finalists) {
+    double gflops = t.measure(config);
+    if (gflops > bestGflops) {
+      bestGflops = gflops;
+      best = config;
+    }
+  }
+
+  printf("Measured %d configurations\n", t.measured);
+  printf("Best: %dx%d, MC %d, KC %d, NC %d: %.2f GFLOPS\n", best.mr, best.nr,
+         best.mc, best.kc, best.nc, bestGflops);
+  gemm_set_config(best);
+  if (save) {
+    if (!gemm_save_config(best)) {
+      fprintf(stderr, "Could not write %s\n", gemm_config_path());
+      return 1;
+    }
+    printf("Saved to %s\n", gemm_config_path());
+  }
+  return 0;
+}